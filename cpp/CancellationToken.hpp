@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+class CancelledError : public std::runtime_error {
+ public:
+  CancelledError() : std::runtime_error("Palette request was cancelled") {}
+};
+
+// Shared flag through which a caller asks long-running work to stop. Copies
+// share the same flag.
+class CancellationToken {
+ public:
+  CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void cancel() const { cancelled->store(true, std::memory_order_relaxed); }
+
+  bool isCancelled() const {
+    return cancelled->load(std::memory_order_relaxed);
+  }
+
+  void throwIfCancelled() const {
+    if (isCancelled()) {
+      throw CancelledError();
+    }
+  }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> cancelled;
+};
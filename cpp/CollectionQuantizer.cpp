@@ -0,0 +1,144 @@
+#include "CollectionQuantizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include "ThreadPool.hpp"
+
+namespace {
+
+// Occupied bins are stored as the gap to the previous bin and the count,
+// both as LEB128 varints, so a bin takes two bytes while its gap and count
+// are both below 128.
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t readVarint(const uint8_t* data, size_t size, size_t& offset) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (offset >= size) {
+      break;
+    }
+    uint8_t byte = data[offset++];
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Invalid histogram data");
+}
+
+}  // namespace
+
+std::vector<MMCQ::Histogram> CollectionQuantizer::makeHistograms(
+    const std::vector<std::vector<uint8_t>>& images, int quality,
+    bool ignoreWhite) {
+  std::vector<MMCQ::Histogram> histograms(images.size());
+  ThreadPool::shared().parallelFor(images.size(), [&](size_t i) {
+    histograms[i] = MMCQ::makeHistogram(images[i], quality, ignoreWhite);
+  });
+  return histograms;
+}
+
+MMCQ::Histogram CollectionQuantizer::merge(
+    const std::vector<MMCQ::Histogram>& histograms,
+    const std::vector<double>& weights) {
+  if (!weights.empty() && weights.size() != histograms.size()) {
+    throw std::runtime_error("Every histogram needs a weight");
+  }
+
+  // Summed in double, which is exact for integer counts far past int range.
+  // A branch-free multiply-add over the dense arrays vectorizes.
+  std::vector<double> sums(MMCQ::HISTOGRAM_SIZE, 0.0);
+  for (size_t i = 0; i < histograms.size(); i++) {
+    const auto& histogram = histograms[i];
+    double weight = weights.empty() ? 1.0 : weights[i];
+    if (!(weight > 0) || !std::isfinite(weight) ||
+        histogram.counts.size() != sums.size()) {
+      continue;
+    }
+
+    const int* counts = histogram.counts.data();
+    double* target = sums.data();
+    for (int bin = 0; bin < MMCQ::HISTOGRAM_SIZE; bin++) {
+      target[bin] += weight * static_cast<double>(counts[bin]);
+    }
+  }
+  return makeNormalized(sums);
+}
+
+std::vector<uint8_t> CollectionQuantizer::serialize(
+    const MMCQ::Histogram& histogram) {
+  std::vector<uint8_t> out(sizeof(MAGIC));
+  std::memcpy(out.data(), &MAGIC, sizeof(MAGIC));
+  out.push_back(VERSION);
+  out.insert(out.end(), {histogram.rMin, histogram.rMax, histogram.gMin,
+                         histogram.gMax, histogram.bMin, histogram.bMax});
+
+  int previous = -1;
+  for (int bin = 0; bin < static_cast<int>(histogram.counts.size()); bin++) {
+    if (histogram.counts[bin] > 0) {
+      writeVarint(out, static_cast<uint32_t>(bin - previous));
+      writeVarint(out, static_cast<uint32_t>(histogram.counts[bin]));
+      previous = bin;
+    }
+  }
+  return out;
+}
+
+MMCQ::Histogram CollectionQuantizer::deserialize(const uint8_t* data,
+                                                 size_t size) {
+  constexpr size_t headerSize = sizeof(MAGIC) + 1 + 6;
+  if (data == nullptr || size < headerSize) {
+    throw std::runtime_error("Invalid histogram data");
+  }
+  uint32_t magic;
+  std::memcpy(&magic, data, sizeof(magic));
+  if (magic != MAGIC || data[sizeof(MAGIC)] != VERSION) {
+    throw std::runtime_error("Invalid histogram data");
+  }
+
+  // The stored bounds are not trusted; they are recomputed from the bins so
+  // they always agree with the counts.
+  std::vector<double> counts(MMCQ::HISTOGRAM_SIZE, 0.0);
+  size_t offset = headerSize;
+  int bin = -1;
+  while (offset < size) {
+    uint32_t gap = readVarint(data, size, offset);
+    uint32_t count = readVarint(data, size, offset);
+    if (gap == 0 || gap >= static_cast<uint32_t>(MMCQ::HISTOGRAM_SIZE - bin) ||
+        count > static_cast<uint32_t>(std::numeric_limits<int>::max())) {
+      throw std::runtime_error("Invalid histogram data");
+    }
+    bin += static_cast<int>(gap);
+    counts[bin] = count;
+  }
+  return makeNormalized(counts);
+}
+
+MMCQ::Histogram CollectionQuantizer::makeNormalized(
+    const std::vector<double>& counts) {
+  double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+  if (!std::isfinite(total)) {
+    throw std::runtime_error("Histogram weights are too large");
+  }
+  double scale = total > MAX_TOTAL ? MAX_TOTAL / total : 1.0;
+
+  MMCQ::Histogram histogram = MMCQ::makeEmptyHistogram();
+  for (int bin = 0; bin < MMCQ::HISTOGRAM_SIZE; bin++) {
+    int count = static_cast<int>(std::lround(counts[bin] * scale));
+    if (count == 0) {
+      continue;
+    }
+    histogram.counts[bin] = count;
+  }
+  MMCQ::fitBounds(histogram);
+  return histogram;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MMCQ.hpp"
+
+// One palette for a set of images. Each image is sampled into its own
+// histogram, in parallel, and the histograms are summed with optional
+// weights before a single cut. Histograms serialize to a compact sparse form
+// so per-image histograms can be computed once and combined many times.
+class CollectionQuantizer {
+ public:
+  static std::vector<MMCQ::Histogram> makeHistograms(
+      const std::vector<std::vector<uint8_t>>& images, int quality,
+      bool ignoreWhite);
+
+  // Adds up the histograms with each count scaled by the histogram's weight.
+  // An empty weight list weighs every histogram 1; histograms with a weight
+  // that is not a positive number are skipped. Totals above MAX_TOTAL are
+  // scaled down to it, so any number of images can be merged. Throws
+  // std::runtime_error when the weights do not match the histograms.
+  static MMCQ::Histogram merge(const std::vector<MMCQ::Histogram>& histograms,
+                               const std::vector<double>& weights);
+
+  static std::vector<uint8_t> serialize(const MMCQ::Histogram& histogram);
+  // Throws std::runtime_error when the data was not written by serialize.
+  // The bounds are recomputed from the bins, and the total is scaled down
+  // as merge does.
+  static MMCQ::Histogram deserialize(const uint8_t* data, size_t size);
+
+ private:
+  static constexpr uint32_t MAGIC = 0x5348504E;  // "NPHS"
+  static constexpr uint8_t VERSION = 1;
+  // Samples a histogram holds at most before it is cut. Keeps every box
+  // count and slice sum of the cut well inside int.
+  static constexpr double MAX_TOTAL = 1 << 24;
+
+  // Rounds the counts, scaled so they add up to at most MAX_TOTAL, and
+  // bounds the histogram by its occupied bins.
+  static MMCQ::Histogram makeNormalized(const std::vector<double>& counts);
+};
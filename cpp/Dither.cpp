@@ -0,0 +1,145 @@
+#include "Dither.hpp"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+void Dither::apply(const uint8_t* pixels, int width, int height,
+                   const MMCQ::ColorMap& colorMap, uint8_t* output,
+                   size_t threadCount) {
+  if (pixels == nullptr || output == nullptr || width < 1 || height < 1) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+  auto palette = colorMap.makePalette();
+  if (palette.empty() ||
+      palette.size() > std::numeric_limits<uint8_t>::max() + 1u) {
+    throw std::runtime_error("Invalid palette");
+  }
+  auto lookupTable = makeLookupTable(palette);
+
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::min({threadCount, MAX_THREADS,
+                          static_cast<size_t>(height)});
+
+  // One spare pixel on each side takes the kernel's spill past the edges.
+  size_t ringSize = threadCount + EXTRA_ERROR_ROWS;
+  std::vector<std::vector<int>> errors(
+      ringSize, std::vector<int>((static_cast<size_t>(width) + 2) * 3, 0));
+  auto progress = std::make_unique<std::atomic<int>[]>(height);
+  for (int y = 0; y < height; y++) {
+    progress[y].store(0, std::memory_order_relaxed);
+  }
+
+  // A thread starts row y once it has finished row y - threadCount, and so
+  // every row above that too; the error row it clears was last used by row
+  // y + 1 - ringSize, which is done by then.
+  auto ditherRows = [&](size_t first) {
+    for (size_t y = first; y < static_cast<size_t>(height);
+         y += threadCount) {
+      ditherRow(pixels, width, static_cast<int>(y), palette, lookupTable,
+                errors[y % ringSize].data() + 3,
+                errors[(y + 1) % ringSize].data() + 3,
+                y > 0 ? &progress[y - 1] : nullptr, progress[y], output);
+    }
+  };
+
+  // Workers wait on each other, so they get their own threads rather than
+  // pool tasks that might be queued behind one another.
+  std::vector<std::thread> workers;
+  workers.reserve(threadCount - 1);
+  for (size_t i = 1; i < threadCount; i++) {
+    workers.emplace_back(ditherRows, i);
+  }
+  ditherRows(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::vector<uint8_t> Dither::makeLookupTable(
+    const std::vector<MMCQ::Color>& palette) {
+  constexpr int size = 1 << MMCQ::SIGNAL_BITS;
+  constexpr int center = 1 << (MMCQ::RIGHT_SHIFT - 1);
+  std::vector<uint8_t> lookupTable(MMCQ::HISTOGRAM_SIZE);
+  for (int r = 0; r < size; r++) {
+    for (int g = 0; g < size; g++) {
+      for (int b = 0; b < size; b++) {
+        int red = (r << MMCQ::RIGHT_SHIFT) + center;
+        int green = (g << MMCQ::RIGHT_SHIFT) + center;
+        int blue = (b << MMCQ::RIGHT_SHIFT) + center;
+        int nearest = 0;
+        int minDistance = std::numeric_limits<int>::max();
+        for (size_t i = 0; i < palette.size(); i++) {
+          int dr = red - palette[i].r;
+          int dg = green - palette[i].g;
+          int db = blue - palette[i].b;
+          int distance = dr * dr + dg * dg + db * db;
+          if (distance < minDistance) {
+            minDistance = distance;
+            nearest = static_cast<int>(i);
+          }
+        }
+        lookupTable[MMCQ::makeColorIndexOf(r, g, b)] =
+            static_cast<uint8_t>(nearest);
+      }
+    }
+  }
+  return lookupTable;
+}
+
+void Dither::ditherRow(const uint8_t* pixels, int width, int y,
+                       const std::vector<MMCQ::Color>& palette,
+                       const std::vector<uint8_t>& lookupTable,
+                       int* currentErrors, int* nextErrors,
+                       const std::atomic<int>* above,
+                       std::atomic<int>& progress, uint8_t* output) {
+  std::fill(nextErrors - 3, nextErrors + (width + 1) * 3, 0);
+
+  const uint8_t* source = pixels + static_cast<size_t>(y) * width * 4;
+  uint8_t* target = output + static_cast<size_t>(y) * width * 4;
+  int ready = above != nullptr ? 0 : width;
+  int carry[3] = {0, 0, 0};
+
+  for (int x = 0; x < width; x++) {
+    // The row above adds to this pixel's error while dithering the pixel to
+    // its right.
+    int needed = std::min(x + 2, width);
+    while (ready < needed) {
+      ready = above->load(std::memory_order_acquire);
+      if (ready < needed) {
+        std::this_thread::yield();
+      }
+    }
+
+    int value[3];
+    for (int c = 0; c < 3; c++) {
+      int error = (currentErrors[x * 3 + c] + carry[c] + 8) >> 4;
+      value[c] = std::clamp(source[x * 4 + c] + error, 0, 255);
+    }
+
+    const MMCQ::Color& color =
+        palette[lookupTable[MMCQ::makeColorIndexOf(
+            value[0] >> MMCQ::RIGHT_SHIFT, value[1] >> MMCQ::RIGHT_SHIFT,
+            value[2] >> MMCQ::RIGHT_SHIFT)]];
+    target[x * 4] = color.r;
+    target[x * 4 + 1] = color.g;
+    target[x * 4 + 2] = color.b;
+    target[x * 4 + 3] = source[x * 4 + 3];
+
+    int quantized[3] = {color.r, color.g, color.b};
+    for (int c = 0; c < 3; c++) {
+      int error = value[c] - quantized[c];
+      carry[c] = 7 * error;
+      nextErrors[(x - 1) * 3 + c] += 3 * error;
+      nextErrors[x * 3 + c] += 5 * error;
+      nextErrors[(x + 1) * 3 + c] += error;
+    }
+
+    if ((x + 1) % PROGRESS_INTERVAL == 0 || x + 1 == width) {
+      progress.store(x + 1, std::memory_order_release);
+    }
+  }
+}
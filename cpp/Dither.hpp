@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Floyd–Steinberg error diffusion to the colors of a ColorMap. Rows are
+// dithered in a wavefront: each thread takes every n-th row and follows the
+// row above it a few pixels behind, which is all the diffusion kernel needs,
+// so rows run concurrently while the output matches a serial pass exactly.
+class Dither {
+ public:
+  // Writes RGBA pixels dithered to the palette of colorMap into output,
+  // which must hold width * height * 4 bytes. Alpha is copied unchanged.
+  // threadCount 0 picks one thread per core. Throws std::runtime_error when
+  // the palette is empty or the size is invalid.
+  static void apply(const uint8_t* pixels, int width, int height,
+                    const MMCQ::ColorMap& colorMap, uint8_t* output,
+                    size_t threadCount = 0);
+
+ private:
+  // Rows in flight never exceed the thread count, so error rows are reused
+  // from a ring two longer than that.
+  static constexpr size_t EXTRA_ERROR_ROWS = 2;
+  static constexpr size_t MAX_THREADS = 8;
+  // Pixels a row finishes between two progress updates. The row below waits
+  // for the pixel to the right of the one it is about to dither.
+  static constexpr int PROGRESS_INTERVAL = 32;
+
+  // Palette index of the color nearest to the center of every histogram
+  // bin.
+  static std::vector<uint8_t> makeLookupTable(
+      const std::vector<MMCQ::Color>& palette);
+
+  // Errors are kept in sixteenths, as the kernel weights them.
+  static void ditherRow(const uint8_t* pixels, int width, int y,
+                        const std::vector<MMCQ::Color>& palette,
+                        const std::vector<uint8_t>& lookupTable,
+                        int* currentErrors, int* nextErrors,
+                        const std::atomic<int>* above,
+                        std::atomic<int>& progress, uint8_t* output);
+};
@@ -0,0 +1,260 @@
+#include "ImageAnalyzer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+const char* const BASE83 =
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;"
+    "=?@[]^_{|}~";
+
+void appendBase83(std::string& out, int value, int length) {
+  int divisor = 1;
+  for (int i = 1; i < length; i++) {
+    divisor *= 83;
+  }
+  for (int i = 0; i < length; i++) {
+    out.push_back(BASE83[(value / divisor) % 83]);
+    divisor /= 83;
+  }
+}
+
+const std::array<float, 256>& getLinearTable() {
+  static const std::array<float, 256> table = [] {
+    std::array<float, 256> values{};
+    for (int i = 0; i < 256; i++) {
+      float v = i / 255.0f;
+      values[i] = v <= 0.04045f ? v / 12.92f
+                                : std::pow((v + 0.055f) / 1.055f, 2.4f);
+    }
+    return values;
+  }();
+  return table;
+}
+
+int toSrgb(float linear) {
+  float v = std::clamp(linear, 0.0f, 1.0f);
+  float srgb = v <= 0.0031308f ? v * 12.92f
+                               : 1.055f * std::pow(v, 1 / 2.4f) - 0.055f;
+  return static_cast<int>(srgb * 255 + 0.5f);
+}
+
+}  // namespace
+
+ImageAnalyzer::Result ImageAnalyzer::analyze(const uint8_t* pixels,
+                                             size_t size, int width,
+                                             int height, unsigned outputs,
+                                             int maxColors, int quality,
+                                             bool ignoreWhite) {
+  if (pixels == nullptr || width <= 0 || height <= 0 ||
+      size != static_cast<size_t>(width) * height * 4) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+
+  static constexpr auto sweeps =
+      makeSweeps(std::make_index_sequence<ALL_OUTPUTS + 1>());
+  outputs &= ALL_OUTPUTS;
+
+  // Images with no more colors than the palette holds get their exact
+  // colors, as MMCQ::quantize gives them. The check stops within a few
+  // samples on photos, so the histogram is then filled by the shared sweep.
+  std::unique_ptr<MMCQ::ColorMap> exact;
+  if (outputs & PALETTE) {
+    exact = MMCQ::makeExactColorMap(pixels, size, maxColors, quality,
+                                    ignoreWhite);
+  }
+  unsigned sweptOutputs = exact ? outputs & ~PALETTE : outputs;
+
+  Sums sums;
+  if (sweptOutputs & PALETTE) {
+    sums.histogram = MMCQ::makeEmptyHistogram();
+  }
+  sweeps[sweptOutputs](pixels, width, height, quality, ignoreWhite, sums);
+
+  Result result;
+  if (exact) {
+    result.palette = exact->makePalette();
+  } else if (outputs & PALETTE) {
+    MMCQ::fitBounds(sums.histogram);
+    if (auto colorMap = MMCQ::quantize(sums.histogram, maxColors)) {
+      result.palette = colorMap->makePalette();
+    }
+  }
+  if ((outputs & AVERAGE) && sums.opaqueCount > 0) {
+    result.average = MMCQ::Color(
+        static_cast<uint8_t>(sums.rSum / sums.opaqueCount),
+        static_cast<uint8_t>(sums.gSum / sums.opaqueCount),
+        static_cast<uint8_t>(sums.bSum / sums.opaqueCount));
+  }
+  if (outputs & LUMINANCE) {
+    result.luminance.resize(LUMINANCE_BINS, 0.0);
+    for (int bin = 0; bin < LUMINANCE_BINS && sums.opaqueCount > 0; bin++) {
+      result.luminance[bin] = static_cast<double>(sums.luminance[bin]) /
+                              static_cast<double>(sums.opaqueCount);
+    }
+  }
+  if ((outputs & PLACEHOLDER) && sums.sampleCount > 0) {
+    result.placeholder = encodePlaceholder(sums);
+  }
+  return result;
+}
+
+template <unsigned Outputs>
+void ImageAnalyzer::sweep(const uint8_t* pixels, int width, int height,
+                          int quality, bool ignoreWhite, Sums& sums) {
+  constexpr bool palette = Outputs & PALETTE;
+  constexpr bool average = Outputs & AVERAGE;
+  constexpr bool luminance = Outputs & LUMINANCE;
+  constexpr bool placeholder = Outputs & PLACEHOLDER;
+  if constexpr (Outputs == 0) {
+    return;
+  }
+
+  // Cosine bases of the placeholder: the x bases of each column together,
+  // the y bases one row per component.
+  std::vector<std::array<float, PLACEHOLDER_X>> basisX;
+  std::vector<float> basisY;
+  if constexpr (placeholder) {
+    basisX.resize(width);
+    basisY.resize(PLACEHOLDER_Y * static_cast<size_t>(height));
+    for (int x = 0; x < width; x++) {
+      for (int i = 0; i < PLACEHOLDER_X; i++) {
+        basisX[x][i] = std::cos(PI * i * x / width);
+      }
+    }
+    for (int j = 0; j < PLACEHOLDER_Y; j++) {
+      for (int y = 0; y < height; y++) {
+        basisY[j * height + y] = std::cos(PI * j * y / height);
+      }
+    }
+  }
+  const auto& linear = getLinearTable();
+
+  MMCQ::Histogram& histogram = sums.histogram;
+  size_t pixelCount = static_cast<size_t>(width) * height;
+  size_t stride = 4 * static_cast<size_t>(quality);
+  // Samples of the current row projected onto the x bases only; the y basis
+  // is the same along a row, so it is applied once per row.
+  std::array<std::array<float, 3>, PLACEHOLDER_X> rowFactors{};
+  auto flushRow = [&](int row) {
+    for (int j = 0; j < PLACEHOLDER_Y; j++) {
+      float cosY = basisY[j * height + row];
+      for (int i = 0; i < PLACEHOLDER_X; i++) {
+        auto& factor = sums.factors[j * PLACEHOLDER_X + i];
+        for (int c = 0; c < 3; c++) {
+          factor[c] += cosY * rowFactors[i][c];
+        }
+      }
+    }
+    rowFactors = {};
+  };
+  int x = 0;
+  int y = 0;
+  for (size_t i = 0; i < pixelCount; i += stride) {
+    const uint8_t* pixel = &pixels[i * 4];
+    uint8_t r = pixel[0];
+    uint8_t g = pixel[1];
+    uint8_t b = pixel[2];
+    uint8_t a = pixel[3];
+
+    if constexpr (palette) {
+      if (!MMCQ::isIgnoredPixel(r, g, b, a, ignoreWhite)) {
+        MMCQ::addSample(histogram, r, g, b);
+      }
+    }
+
+    if constexpr (average || luminance) {
+      if (a > 125) {
+        sums.opaqueCount++;
+        if constexpr (average) {
+          sums.rSum += r;
+          sums.gSum += g;
+          sums.bSum += b;
+        }
+        if constexpr (luminance) {
+          // Rec. 709 luma with weights summing to 256.
+          int luma = (54 * r + 183 * g + 19 * b) >> 8;
+          sums.luminance[luma * LUMINANCE_BINS / 256]++;
+        }
+      }
+    }
+
+    if constexpr (placeholder) {
+      float linearR = linear[r];
+      float linearG = linear[g];
+      float linearB = linear[b];
+      for (int k = 0; k < PLACEHOLDER_X; k++) {
+        float basis = basisX[x][k];
+        rowFactors[k][0] += basis * linearR;
+        rowFactors[k][1] += basis * linearG;
+        rowFactors[k][2] += basis * linearB;
+      }
+      sums.sampleCount++;
+
+      // Track the sample's position instead of dividing for it.
+      int row = y;
+      x += static_cast<int>(stride % width);
+      y += static_cast<int>(stride / width);
+      if (x >= width) {
+        x -= width;
+        y++;
+      }
+      if (y != row) {
+        flushRow(row);
+      }
+    }
+  }
+
+  if constexpr (placeholder) {
+    if (y < height) {
+      flushRow(y);
+    }
+  }
+}
+
+std::string ImageAnalyzer::encodePlaceholder(const Sums& sums) {
+  // The DC term is the plain mean; the AC terms are scaled by 2 as BlurHash
+  // expects.
+  std::array<std::array<float, 3>, PLACEHOLDER_COMPONENTS> factors;
+  for (int i = 0; i < PLACEHOLDER_COMPONENTS; i++) {
+    float scale = (i == 0 ? 1.0f : 2.0f) / sums.sampleCount;
+    for (int c = 0; c < 3; c++) {
+      factors[i][c] = sums.factors[i][c] * scale;
+    }
+  }
+
+  std::string hash;
+  appendBase83(hash, (PLACEHOLDER_X - 1) + (PLACEHOLDER_Y - 1) * 9, 1);
+
+  float maximum = 0;
+  for (int i = 1; i < PLACEHOLDER_COMPONENTS; i++) {
+    for (int c = 0; c < 3; c++) {
+      maximum = std::max(maximum, std::abs(factors[i][c]));
+    }
+  }
+  int quantizedMaximum =
+      std::clamp(static_cast<int>(std::floor(maximum * 166 - 0.5f)), 0, 82);
+  float acScale = (quantizedMaximum + 1) / 166.0f;
+  appendBase83(hash, quantizedMaximum, 1);
+
+  appendBase83(hash,
+               (toSrgb(factors[0][0]) << 16) + (toSrgb(factors[0][1]) << 8) +
+                   toSrgb(factors[0][2]),
+               4);
+
+  for (int i = 1; i < PLACEHOLDER_COMPONENTS; i++) {
+    int value = 0;
+    for (int c = 0; c < 3; c++) {
+      float v = factors[i][c] / acScale;
+      float signedRoot = std::copysign(std::sqrt(std::abs(v)), v);
+      value = value * 19 +
+              std::clamp(static_cast<int>(std::floor(signedRoot * 9 + 9.5f)),
+                         0, 18);
+    }
+    appendBase83(hash, value, 2);
+  }
+  return hash;
+}
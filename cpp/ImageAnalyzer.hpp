@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Several summaries of one RGBA image from a single sweep over its samples:
+// the palette histogram, the average color, a luminance histogram for
+// picking light or dark themes, and a BlurHash placeholder. Each output is
+// requested by a flag, and every combination of flags is its own
+// instantiation of the sweep, so outputs that were not asked for cost
+// nothing per pixel.
+class ImageAnalyzer {
+ public:
+  enum Output : unsigned {
+    PALETTE = 1 << 0,
+    AVERAGE = 1 << 1,
+    LUMINANCE = 1 << 2,
+    PLACEHOLDER = 1 << 3,
+  };
+
+  static constexpr int LUMINANCE_BINS = 32;
+
+  // Outputs that were not requested are left empty.
+  struct Result {
+    std::vector<MMCQ::Color> palette;
+    std::optional<MMCQ::Color> average;
+    // Fraction of the opaque samples in each luminance bin, darkest first.
+    std::vector<double> luminance;
+    std::string placeholder;
+  };
+
+  // Samples every 4 * quality-th pixel, as MMCQ does; the palette leaves out
+  // the pixels MMCQ ignores, the average and luminance histogram only the
+  // mostly transparent ones. The palette is the one MMCQ::quantize gives,
+  // exact colors included. Throws std::runtime_error when width and height
+  // do not describe the pixels.
+  static Result analyze(const uint8_t* pixels, size_t size, int width,
+                        int height, unsigned outputs, int maxColors,
+                        int quality, bool ignoreWhite);
+
+ private:
+  static constexpr unsigned ALL_OUTPUTS =
+      PALETTE | AVERAGE | LUMINANCE | PLACEHOLDER;
+  // BlurHash components along each axis.
+  static constexpr int PLACEHOLDER_X = 4;
+  static constexpr int PLACEHOLDER_Y = 3;
+  static constexpr int PLACEHOLDER_COMPONENTS = PLACEHOLDER_X * PLACEHOLDER_Y;
+
+  struct Sums {
+    MMCQ::Histogram histogram;
+    uint64_t rSum = 0;
+    uint64_t gSum = 0;
+    uint64_t bSum = 0;
+    uint64_t opaqueCount = 0;
+    std::array<uint64_t, LUMINANCE_BINS> luminance{};
+    // Linear RGB projected onto each cosine basis, row by row.
+    std::array<std::array<float, 3>, PLACEHOLDER_COMPONENTS> factors{};
+    uint64_t sampleCount = 0;
+  };
+
+  using Sweep = void (*)(const uint8_t* pixels, int width, int height,
+                         int quality, bool ignoreWhite, Sums& sums);
+
+  template <unsigned Outputs>
+  static void sweep(const uint8_t* pixels, int width, int height,
+                    int quality, bool ignoreWhite, Sums& sums);
+
+  template <size_t... Outputs>
+  static constexpr std::array<Sweep, sizeof...(Outputs)> makeSweeps(
+      std::index_sequence<Outputs...>) {
+    return {&sweep<Outputs>...};
+  }
+
+  static std::string encodePlaceholder(const Sums& sums);
+};
@@ -0,0 +1,270 @@
+#include "ImageDecoder.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreGraphics/CoreGraphics.h>
+#include <ImageIO/ImageIO.h>
+#elif defined(__ANDROID__)
+#include <android/bitmap.h>
+#include <android/imagedecoder.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__APPLE__)
+
+// Bitmap contexts only draw 8-bit RGBA with premultiplied alpha, while every
+// other pixel source (and AImageDecoder on Android) is straight alpha, so
+// the colors are divided back out.
+void unpremultiply(std::vector<uint8_t>& pixels) {
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    int alpha = pixels[i + 3];
+    if (alpha == 0 || alpha == 255) {
+      continue;
+    }
+    for (size_t c = i; c < i + 3; c++) {
+      pixels[c] = static_cast<uint8_t>(
+          std::min(255, (pixels[c] * 255 + alpha / 2) / alpha));
+    }
+  }
+}
+
+ImageDecoder::Image decodeSource(CGImageSourceRef source, int maxDimension) {
+  if (source == nullptr) {
+    throw std::runtime_error("Failed to read image data");
+  }
+
+  // Thumbnails are decoded at the requested size, which lets the JPEG codec
+  // use its scaled IDCT instead of decoding every pixel.
+  CFNumberRef maxPixelSize =
+      CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &maxDimension);
+  const void* keys[] = {kCGImageSourceCreateThumbnailFromImageAlways,
+                        kCGImageSourceCreateThumbnailWithTransform,
+                        kCGImageSourceThumbnailMaxPixelSize};
+  const void* values[] = {kCFBooleanTrue, kCFBooleanTrue, maxPixelSize};
+  CFDictionaryRef options = CFDictionaryCreate(
+      kCFAllocatorDefault, keys, values, 3, &kCFTypeDictionaryKeyCallBacks,
+      &kCFTypeDictionaryValueCallBacks);
+  CGImageRef thumbnail = CGImageSourceCreateThumbnailAtIndex(source, 0, options);
+  CFRelease(options);
+  CFRelease(maxPixelSize);
+  CFRelease(source);
+  if (thumbnail == nullptr) {
+    throw std::runtime_error("Failed to decode image");
+  }
+
+  ImageDecoder::Image image;
+  image.width = static_cast<int>(CGImageGetWidth(thumbnail));
+  image.height = static_cast<int>(CGImageGetHeight(thumbnail));
+  image.pixels.assign(static_cast<size_t>(image.width) * image.height * 4, 0);
+
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+  CGContextRef context = CGBitmapContextCreate(
+      image.pixels.data(), image.width, image.height, 8,
+      static_cast<size_t>(image.width) * 4, colorSpace,
+      kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+  CGColorSpaceRelease(colorSpace);
+  if (context == nullptr) {
+    CGImageRelease(thumbnail);
+    throw std::runtime_error("Failed to allocate bitmap");
+  }
+  CGContextDrawImage(context, CGRectMake(0, 0, image.width, image.height),
+                     thumbnail);
+  CGContextRelease(context);
+  CGImageRelease(thumbnail);
+  unpremultiply(image.pixels);
+  return image;
+}
+
+#elif defined(__ANDROID__)
+
+// AImageDecoder only exists from API 30 while the library supports older
+// devices, so its entry points are resolved at runtime.
+struct ImageDecoderApi {
+  int (*createFromBuffer)(const void*, size_t, AImageDecoder**);
+  int (*createFromFd)(int, AImageDecoder**);
+  const AImageDecoderHeaderInfo* (*getHeaderInfo)(const AImageDecoder*);
+  int32_t (*getWidth)(const AImageDecoderHeaderInfo*);
+  int32_t (*getHeight)(const AImageDecoderHeaderInfo*);
+  int (*setAndroidBitmapFormat)(AImageDecoder*, int32_t);
+  int (*setUnpremultipliedRequired)(AImageDecoder*, bool);
+  int (*setTargetSize)(AImageDecoder*, int32_t, int32_t);
+  size_t (*getMinimumStride)(AImageDecoder*);
+  int (*decodeImage)(AImageDecoder*, void*, size_t, size_t);
+  void (*destroy)(AImageDecoder*);
+  bool available;
+};
+
+template <typename Function>
+bool loadSymbol(void* library, const char* name, Function& function) {
+  function = reinterpret_cast<Function>(dlsym(library, name));
+  return function != nullptr;
+}
+
+const ImageDecoderApi& getImageDecoderApi() {
+  static const ImageDecoderApi api = []() {
+    ImageDecoderApi api{};
+    void* library = dlopen("libjnigraphics.so", RTLD_NOW);
+    if (library == nullptr) {
+      return api;
+    }
+    api.available =
+        loadSymbol(library, "AImageDecoder_createFromBuffer",
+                   api.createFromBuffer) &&
+        loadSymbol(library, "AImageDecoder_createFromFd", api.createFromFd) &&
+        loadSymbol(library, "AImageDecoder_getHeaderInfo",
+                   api.getHeaderInfo) &&
+        loadSymbol(library, "AImageDecoderHeaderInfo_getWidth",
+                   api.getWidth) &&
+        loadSymbol(library, "AImageDecoderHeaderInfo_getHeight",
+                   api.getHeight) &&
+        loadSymbol(library, "AImageDecoder_setAndroidBitmapFormat",
+                   api.setAndroidBitmapFormat) &&
+        loadSymbol(library, "AImageDecoder_setUnpremultipliedRequired",
+                   api.setUnpremultipliedRequired) &&
+        loadSymbol(library, "AImageDecoder_setTargetSize",
+                   api.setTargetSize) &&
+        loadSymbol(library, "AImageDecoder_getMinimumStride",
+                   api.getMinimumStride) &&
+        loadSymbol(library, "AImageDecoder_decodeImage", api.decodeImage) &&
+        loadSymbol(library, "AImageDecoder_delete", api.destroy);
+    return api;
+  }();
+  return api;
+}
+
+const ImageDecoderApi& requireImageDecoderApi() {
+  const auto& api = getImageDecoderApi();
+  if (!api.available) {
+    throw std::runtime_error("Image decoding requires Android 11 or later");
+  }
+  return api;
+}
+
+ImageDecoder::Image decodeWith(AImageDecoder* decoder, int maxDimension) {
+  const auto& api = getImageDecoderApi();
+  const AImageDecoderHeaderInfo* info = api.getHeaderInfo(decoder);
+  int32_t width = api.getWidth(info);
+  int32_t height = api.getHeight(info);
+
+  // The decoder picks the codec's sampled size (scaled IDCT for JPEG) for
+  // the target and only scales the remainder.
+  int32_t longest = std::max(width, height);
+  if (longest > maxDimension) {
+    width = std::max<int32_t>(1, static_cast<int64_t>(width) * maxDimension /
+                                     longest);
+    height = std::max<int32_t>(1, static_cast<int64_t>(height) *
+                                      maxDimension / longest);
+  }
+
+  api.setAndroidBitmapFormat(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+  api.setUnpremultipliedRequired(decoder, true);
+  if (api.setTargetSize(decoder, width, height) !=
+      ANDROID_IMAGE_DECODER_SUCCESS) {
+    throw std::runtime_error("Failed to scale image");
+  }
+
+  size_t stride = api.getMinimumStride(decoder);
+  std::vector<uint8_t> buffer(stride * height);
+  int decoded =
+      api.decodeImage(decoder, buffer.data(), stride, buffer.size());
+  if (decoded != ANDROID_IMAGE_DECODER_SUCCESS &&
+      decoded != ANDROID_IMAGE_DECODER_INCOMPLETE) {
+    throw std::runtime_error("Failed to decode image");
+  }
+
+  ImageDecoder::Image image{std::move(buffer), width, height};
+  size_t rowSize = static_cast<size_t>(width) * 4;
+  if (stride != rowSize) {
+    for (int32_t y = 1; y < height; y++) {
+      std::copy_n(&image.pixels[y * stride], rowSize,
+                  &image.pixels[y * rowSize]);
+    }
+    image.pixels.resize(rowSize * height);
+  }
+  return image;
+}
+
+#endif
+
+}  // namespace
+
+ImageDecoder::Image ImageDecoder::decode(const uint8_t* data, size_t size,
+                                         int maxDimension) {
+  if (data == nullptr || size == 0 || maxDimension < 1) {
+    throw std::runtime_error("Invalid image data");
+  }
+
+#if defined(__APPLE__)
+  CFDataRef encoded = CFDataCreateWithBytesNoCopy(
+      kCFAllocatorDefault, data, static_cast<CFIndex>(size), kCFAllocatorNull);
+  CGImageSourceRef source = CGImageSourceCreateWithData(encoded, nullptr);
+  CFRelease(encoded);
+  return decodeSource(source, maxDimension);
+#elif defined(__ANDROID__)
+  const auto& api = requireImageDecoderApi();
+  AImageDecoder* decoder = nullptr;
+  if (api.createFromBuffer(data, size, &decoder) !=
+      ANDROID_IMAGE_DECODER_SUCCESS) {
+    throw std::runtime_error("Failed to read image data");
+  }
+  try {
+    Image image = decodeWith(decoder, maxDimension);
+    api.destroy(decoder);
+    return image;
+  } catch (...) {
+    api.destroy(decoder);
+    throw;
+  }
+#else
+  throw std::runtime_error("Image decoding is not supported on this platform");
+#endif
+}
+
+ImageDecoder::Image ImageDecoder::decodeFile(const std::string& path,
+                                             int maxDimension) {
+  if (maxDimension < 1) {
+    throw std::runtime_error("Invalid image size");
+  }
+
+#if defined(__APPLE__)
+  CFURLRef url = CFURLCreateFromFileSystemRepresentation(
+      kCFAllocatorDefault, reinterpret_cast<const UInt8*>(path.c_str()),
+      static_cast<CFIndex>(path.size()), false);
+  if (url == nullptr) {
+    throw std::runtime_error("Invalid image path");
+  }
+  CGImageSourceRef source = CGImageSourceCreateWithURL(url, nullptr);
+  CFRelease(url);
+  return decodeSource(source, maxDimension);
+#elif defined(__ANDROID__)
+  const auto& api = requireImageDecoderApi();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open image file");
+  }
+  AImageDecoder* decoder = nullptr;
+  if (api.createFromFd(fd, &decoder) != ANDROID_IMAGE_DECODER_SUCCESS) {
+    close(fd);
+    throw std::runtime_error("Failed to read image data");
+  }
+  try {
+    Image image = decodeWith(decoder, maxDimension);
+    api.destroy(decoder);
+    close(fd);
+    return image;
+  } catch (...) {
+    api.destroy(decoder);
+    close(fd);
+    throw;
+  }
+#else
+  (void)path;
+  throw std::runtime_error("Image decoding is not supported on this platform");
+#endif
+}
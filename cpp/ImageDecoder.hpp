@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decodes encoded images (JPEG, PNG, WebP, ...) straight to a small RGBA
+// buffer with the platform codec: ImageIO thumbnails on Apple platforms and
+// AImageDecoder on Android. Both scale JPEGs in the DCT domain and subsample
+// other formats while decoding, so the full-size bitmap is never allocated.
+// Pixels come back with straight alpha, as from every other source. On
+// Android, AImageDecoder needs API 30; decoding throws on older devices.
+class ImageDecoder {
+ public:
+  struct Image {
+    std::vector<uint8_t> pixels;
+    int width;
+    int height;
+  };
+
+  // The longer side of the decoded image is at most maxDimension. Throws
+  // std::runtime_error when the data cannot be decoded.
+  static Image decode(const uint8_t* data, size_t size, int maxDimension);
+  static Image decodeFile(const std::string& path, int maxDimension);
+};
@@ -1,11 +1,13 @@
 #include "MMCQ.hpp"
+#include "ThreadPool.hpp"
 #include <NitroModules/ArrayBuffer.hpp>
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <numeric>
-#include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -21,7 +23,7 @@ std::vector<MMCQ::Color> MMCQ::ColorMap::makePalette() const {
   palette.reserve(vboxes.size());
 
   for (const auto& vbox : vboxes) {
-    palette.push_back(vbox.getAverage());
+    palette.push_back(vbox.average);
   }
 
   return palette;
@@ -32,7 +34,7 @@ MMCQ::Color MMCQ::ColorMap::makeNearestColor(const MMCQ::Color& color) const {
   MMCQ::Color nearestColor(0, 0, 0);
 
   for (const auto& vbox : vboxes) {
-    MMCQ::Color vboxColor = vbox.getAverage();
+    MMCQ::Color vboxColor = vbox.average;
     int dr =
         std::abs(static_cast<int>(color.r) - static_cast<int>(vboxColor.r));
     int dg =
@@ -50,6 +52,10 @@ MMCQ::Color MMCQ::ColorMap::makeNearestColor(const MMCQ::Color& color) const {
 
 void MMCQ::ColorMap::push(const MMCQ::VBox& vbox) { vboxes.push_back(vbox); }
 
+const std::vector<MMCQ::VBox>& MMCQ::ColorMap::getVBoxes() const {
+  return vboxes;
+}
+
 MMCQ::ColorMap::ColorMap(const ColorMap& other) : vboxes(other.vboxes) {}
 
 MMCQ::ColorMap& MMCQ::ColorMap::operator=(const ColorMap& other) {
@@ -59,129 +65,68 @@ MMCQ::ColorMap& MMCQ::ColorMap::operator=(const ColorMap& other) {
   return *this;
 }
 
-MMCQ::VBox::VBox(uint8_t rMin, uint8_t rMax, uint8_t gMin, uint8_t gMax,
-                 uint8_t bMin, uint8_t bMax, std::vector<int>& histogram)
-    : rMin(rMin),
-      rMax(rMax),
-      gMin(gMin),
-      gMax(gMax),
-      bMin(bMin),
-      bMax(bMax),
-      histogram(std::make_shared<std::vector<int>>(histogram)) {}
-
-MMCQ::VBox::VBox(const VBox& vbox)
-    : rMin(vbox.rMin),
-      rMax(vbox.rMax),
-      gMin(vbox.gMin),
-      gMax(vbox.gMax),
-      bMin(vbox.bMin),
-      bMax(vbox.bMax),
-      histogram(vbox.histogram) {}
-
-MMCQ::VBox& MMCQ::VBox::operator=(const VBox& other) {
-  if (this != &other) {
-    rMin = other.rMin;
-    rMax = other.rMax;
-    gMin = other.gMin;
-    gMax = other.gMax;
-    bMin = other.bMin;
-    bMax = other.bMax;
-    histogram = other.histogram;
-    average = other.average;
-    volume = other.volume;
-    count = other.count;
-  }
-  return *this;
-}
-
-int MMCQ::VBox::getVolume(bool forceRecalculation) const {
-  if (!forceRecalculation && volume.has_value()) {
-    return volume.value();
-  } else {
-    int newVolume = (static_cast<int>(rMax) - rMin + 1) *
-                    (static_cast<int>(gMax) - gMin + 1) *
-                    (static_cast<int>(bMax) - bMin + 1);
-    return newVolume;
-  }
-}
-
-int MMCQ::VBox::getCount(bool forceRecalculation) const {
-  if (!forceRecalculation && count.has_value()) {
-    return count.value();
-  } else {
-    int totalCount = 0;
-    for (int index = 0; index < HISTOGRAM_SIZE; index++) {
-      int histogramValue = histogram->at(index);
-      if (histogramValue == 0) {
-        continue;
-      }
-      int r = (index >> (2 * SIGNAL_BITS)) & MASK;
-      int g = (index >> SIGNAL_BITS) & MASK;
-      int b = index & MASK;
-
-      if (r >= rMin && r <= rMax && g >= gMin && g <= gMax && b >= bMin &&
-          b <= bMax) {
-        totalCount += histogramValue;
-      }
-    }
-
-    count = totalCount;
-    return totalCount;
+template <int Bits>
+MMCQ::VBox MMCQ::makeVBox(const std::vector<Bin>& bins, uint8_t rMin,
+                          uint8_t rMax, uint8_t gMin, uint8_t gMax,
+                          uint8_t bMin, uint8_t bMax, VBox::Range range) {
+  constexpr int multiplier = 1 << (8 - Bits);
+  constexpr int mask = (1 << Bits) - 1;
+
+  VBox vbox;
+  vbox.rMin = rMin;
+  vbox.rMax = rMax;
+  vbox.gMin = gMin;
+  vbox.gMax = gMax;
+  vbox.bMin = bMin;
+  vbox.bMax = bMax;
+  vbox.range = range;
+  vbox.volume = (static_cast<int>(rMax) - rMin + 1) *
+                (static_cast<int>(gMax) - gMin + 1) *
+                (static_cast<int>(bMax) - bMin + 1);
+
+  // Channel sums reach about 252 per sample, past int range for boxes of
+  // merged histograms.
+  int64_t histogramValueSum = 0;
+  int64_t rSum = 0;
+  int64_t gSum = 0;
+  int64_t bSum = 0;
+
+  for (int i = range.begin; i < range.end; i++) {
+    const Bin& bin = bins[i];
+    int histogramValue = bin.count;
+    int r = (bin.index >> (2 * Bits)) & mask;
+    int g = (bin.index >> Bits) & mask;
+    int b = bin.index & mask;
+
+    histogramValueSum += histogramValue;
+
+    rSum += static_cast<int64_t>(histogramValue * (r + 0.5) * multiplier);
+    gSum += static_cast<int64_t>(histogramValue * (g + 0.5) * multiplier);
+    bSum += static_cast<int64_t>(histogramValue * (b + 0.5) * multiplier);
   }
-}
-
-MMCQ::Color MMCQ::VBox::getAverage(bool forceRecalculation) const {
-  if (!forceRecalculation && average.has_value()) {
-    return average.value();
-  } else {
-    int histogramValueSum = 0;
-    int rSum = 0;
-    int gSum = 0;
-    int bSum = 0;
-
-    for (int index = 0; index < HISTOGRAM_SIZE; index++) {
-      int histogramValue = histogram->at(index);
-      if (histogramValue == 0) {
-        continue;
-      }
-      int r = (index >> (2 * SIGNAL_BITS)) & MASK;
-      int g = (index >> SIGNAL_BITS) & MASK;
-      int b = index & MASK;
 
-      if (r >= rMin && r <= rMax && g >= gMin && g <= gMax && b >= bMin &&
-          b <= bMax) {
-        histogramValueSum += histogramValue;
-
-        rSum += static_cast<int>(histogramValue * (r + 0.5) * MULTIPLIER);
-        gSum += static_cast<int>(histogramValue * (g + 0.5) * MULTIPLIER);
-        bSum += static_cast<int>(histogramValue * (b + 0.5) * MULTIPLIER);
-      }
-    }
-
-    average.emplace(histogramValueSum > 0
-                        ? Color(static_cast<uint8_t>(rSum / histogramValueSum),
-                                static_cast<uint8_t>(gSum / histogramValueSum),
-                                static_cast<uint8_t>(bSum / histogramValueSum))
-                        : Color(static_cast<uint8_t>(
-                                    std::min(MULTIPLIER *
-                                                 (static_cast<int>(rMin) +
-                                                  static_cast<int>(rMax) + 1) /
-                                                 2,
-                                             255)),
-                                static_cast<uint8_t>(
-                                    std::min(MULTIPLIER *
-                                                 (static_cast<int>(gMin) +
-                                                  static_cast<int>(gMax) + 1) /
-                                                 2,
-                                             255)),
-                                static_cast<uint8_t>(
-                                    std::min(MULTIPLIER *
-                                                 (static_cast<int>(bMin) +
-                                                  static_cast<int>(bMax) + 1) /
-                                                 2,
-                                             255))));
-    return average.value();
-  }
+  vbox.count = static_cast<int>(histogramValueSum);
+  vbox.average =
+      histogramValueSum > 0
+          ? Color(static_cast<uint8_t>(rSum / histogramValueSum),
+                  static_cast<uint8_t>(gSum / histogramValueSum),
+                  static_cast<uint8_t>(bSum / histogramValueSum))
+          : Color(static_cast<uint8_t>(std::min(
+                      multiplier *
+                          (static_cast<int>(rMin) + static_cast<int>(rMax) + 1) /
+                          2,
+                      255)),
+                  static_cast<uint8_t>(std::min(
+                      multiplier *
+                          (static_cast<int>(gMin) + static_cast<int>(gMax) + 1) /
+                          2,
+                      255)),
+                  static_cast<uint8_t>(std::min(
+                      multiplier *
+                          (static_cast<int>(bMin) + static_cast<int>(bMax) + 1) /
+                          2,
+                      255)));
+  return vbox;
 }
 
 MMCQ::ColorChannel MMCQ::VBox::widestColorChannel() const {
@@ -200,22 +145,122 @@ MMCQ::ColorChannel MMCQ::VBox::widestColorChannel() const {
 
 std::unique_ptr<MMCQ::ColorMap> MMCQ::quantize(
     const std::vector<uint8_t>& pixels, int maxColors, int quality,
-    bool ignoreWhite) {
+    bool ignoreWhite, const CancellationToken* token) {
+  if (pixels.empty() || maxColors < 1 || maxColors > 255) {
+    return nullptr;
+  }
+
+  // Flat artwork often has no more colors than were asked for; those are
+  // returned exactly instead of as box averages.
+  if (auto exact =
+          makeExactColorMap(pixels.data(), pixels.size(), maxColors, quality,
+                            ignoreWhite, token)) {
+    return exact;
+  }
+
+  return quantize(makeHistogramAndBox(pixels, quality, ignoreWhite, token),
+                  maxColors, token);
+}
+
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantize(
+    const Histogram& histogram, int maxColors,
+    const CancellationToken* token) {
+  if (maxColors < 1 || maxColors > 255) {
+    return nullptr;
+  }
+
+  return quantizeBins<SIGNAL_BITS>(
+      makeOccupiedBins(histogram.counts), histogram.rMin, histogram.rMax,
+      histogram.gMin, histogram.gMax, histogram.bMin, histogram.bMax,
+      maxColors, token);
+}
+
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantize(
+    std::vector<Bin> bins, int maxColors, const CancellationToken* token) {
+  if (maxColors < 1 || maxColors > 255) {
+    return nullptr;
+  }
+
+  return quantizeSparse<SIGNAL_BITS>(std::move(bins), maxColors, token);
+}
+
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantizeWithCuts(
+    const std::vector<uint8_t>& pixels, int maxColors, int quality,
+    bool ignoreWhite, std::vector<Cut>& cuts, const CancellationToken* token) {
+  if (pixels.empty() || maxColors < 1 || maxColors > 255) {
+    return nullptr;
+  }
+
+  Histogram histogram =
+      makeHistogramAndBox(pixels, quality, ignoreWhite, token);
+  return quantizeBins<SIGNAL_BITS>(
+      makeOccupiedBins(histogram.counts), histogram.rMin, histogram.rMax,
+      histogram.gMin, histogram.gMax, histogram.bMin, histogram.bMax,
+      maxColors, token, &cuts);
+}
+
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantizeRefined(
+    const std::vector<uint8_t>& pixels, int maxColors, int quality,
+    bool ignoreWhite, const CancellationToken* token) {
   if (pixels.empty() || maxColors < 1 || maxColors > 255) {
     return nullptr;
   }
 
-  std::pair<std::vector<int, std::allocator<int>>, VBox> histogramAndBox =
-      makeHistogramAndBox(pixels, quality, ignoreWhite);
+  if (auto exact =
+          makeExactColorMap(pixels.data(), pixels.size(), maxColors, quality,
+                            ignoreWhite, token)) {
+    return exact;
+  }
+
+  return quantizeSparse<FINE_SIGNAL_BITS>(
+      makeRefinedBins(pixels, quality, ignoreWhite, token), maxColors, token);
+}
+
+template <int Bits>
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantizeSparse(
+    std::vector<Bin> bins, int maxColors, const CancellationToken* token) {
+  uint8_t rMin = std::numeric_limits<uint8_t>::max();
+  uint8_t gMin = std::numeric_limits<uint8_t>::max();
+  uint8_t bMin = std::numeric_limits<uint8_t>::max();
+  uint8_t rMax = std::numeric_limits<uint8_t>::min();
+  uint8_t gMax = std::numeric_limits<uint8_t>::min();
+  uint8_t bMax = std::numeric_limits<uint8_t>::min();
+  for (const auto& bin : bins) {
+    auto r =
+        static_cast<uint8_t>(makeChannelOf<Bits>(bin.index, ColorChannel::R));
+    auto g =
+        static_cast<uint8_t>(makeChannelOf<Bits>(bin.index, ColorChannel::G));
+    auto b =
+        static_cast<uint8_t>(makeChannelOf<Bits>(bin.index, ColorChannel::B));
+    rMin = std::min(rMin, r);
+    gMin = std::min(gMin, g);
+    bMin = std::min(bMin, b);
+    rMax = std::max(rMax, r);
+    gMax = std::max(gMax, g);
+    bMax = std::max(bMax, b);
+  }
+
+  return quantizeBins<Bits>(std::move(bins), rMin, rMax, gMin, gMax, bMin,
+                            bMax, maxColors, token);
+}
+
+template <int Bits>
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantizeBins(
+    std::vector<Bin> bins, uint8_t rMin, uint8_t rMax, uint8_t gMin,
+    uint8_t gMax, uint8_t bMin, uint8_t bMax, int maxColors,
+    const CancellationToken* token, std::vector<Cut>* cuts) {
+  // The occupied bins are the only state the cuts touch; boxes are plain
+  // values holding slices of this list.
   std::vector<VBox> pqueue;
-  pqueue.reserve(maxColors);
-  pqueue.push_back(histogramAndBox.second);
+  pqueue.reserve(maxColors + 1);
+  pqueue.push_back(makeVBox<Bits>(bins, rMin, rMax, gMin, gMax, bMin, bMax,
+                                  {0, static_cast<int>(bins.size())}));
   int target = static_cast<int>(FRACTION_BY_POPULATION * maxColors);
 
-  iterate(pqueue, compareByCount, target, histogramAndBox.first);
+  iterate<Bits>(pqueue, compareByCount, target, bins, token, cuts);
   std::sort(pqueue.begin(), pqueue.end(), compareByProduct);
 
-  iterate(pqueue, compareByProduct, maxColors, histogramAndBox.first);
+  iterate<Bits>(pqueue, compareByProduct, maxColors, bins, token, cuts);
   std::reverse(pqueue.begin(), pqueue.end());
 
   MMCQ::ColorMap colorMap;
@@ -225,72 +270,416 @@ std::unique_ptr<MMCQ::ColorMap> MMCQ::quantize(
   return std::make_unique<ColorMap>(colorMap);
 }
 
-int MMCQ::makeColorIndexOf(int red, int green, int blue) {
-  return (red << (2 * SIGNAL_BITS)) + (green << SIGNAL_BITS) + blue;
+std::unique_ptr<MMCQ::ColorMap> MMCQ::quantizeFromCuts(
+    const Histogram& histogram, int maxColors,
+    const std::vector<Cut>& previous, float tolerance,
+    std::vector<Cut>& cuts, const CancellationToken* token) {
+  if (maxColors < 1 || maxColors > 255) {
+    return nullptr;
+  }
+
+  std::vector<Bin> bins = makeOccupiedBins(histogram.counts);
+  std::vector<VBox> pqueue;
+  pqueue.reserve(maxColors + 1);
+  pqueue.push_back(makeVBox<SIGNAL_BITS>(
+      bins, histogram.rMin, histogram.rMax, histogram.gMin, histogram.gMax,
+      histogram.bMin, histogram.bMax, {0, static_cast<int>(bins.size())}));
+
+  // Populated boxes own disjoint slices of the bin list, so an earlier box
+  // is known by its whole slice until it is cut, and maps to the queue
+  // entry standing in for it. Empty boxes are never cut and are left out,
+  // since their empty slice can match a neighbour's.
+  auto makeSliceKey = [](const VBox& vbox) {
+    return static_cast<uint64_t>(vbox.range.begin) << 32 |
+           static_cast<uint32_t>(vbox.range.end);
+  };
+  std::unordered_map<uint64_t, size_t> boxOfPrevious;
+  if (!previous.empty()) {
+    boxOfPrevious.emplace(makeSliceKey(previous.front().parent), 0);
+  }
+  auto replay = [&](size_t begin, size_t end, int limit) {
+    int replayed = 0;
+    VBox vboxes[2];
+    for (size_t i = begin; i < end && replayed < limit; i++) {
+      const Cut& cut = previous[i];
+      auto it = boxOfPrevious.find(makeSliceKey(cut.parent));
+      if (it == boxOfPrevious.end()) {
+        continue;
+      }
+      size_t box = it->second;
+      boxOfPrevious.erase(it);
+      if (replayCut(bins, pqueue[box], cut, tolerance, vboxes) != 2) {
+        continue;
+      }
+      cuts.push_back({pqueue[box], {vboxes[0], vboxes[1]}, cut.byPopulation});
+      pqueue[box] = vboxes[0];
+      pqueue.push_back(vboxes[1]);
+      // replayCut only succeeds when both earlier children were populated.
+      boxOfPrevious.emplace(makeSliceKey(cut.children[0]), box);
+      boxOfPrevious.emplace(makeSliceKey(cut.children[1]), pqueue.size() - 1);
+      replayed++;
+    }
+    return replayed;
+  };
+
+  // The two passes of quantizeBins, each replaying the earlier cuts it made
+  // before cutting afresh. iterate makes target - 1 cuts in a pass, and at
+  // least one, unless it runs out of boxes to cut; the earlier cuts are
+  // told apart by the pass that made them rather than by that count.
+  size_t firstPassEnd = static_cast<size_t>(
+      std::find_if(previous.begin(), previous.end(),
+                   [](const Cut& cut) { return !cut.byPopulation; }) -
+      previous.begin());
+  int target = static_cast<int>(FRACTION_BY_POPULATION * maxColors);
+  int firstPassCuts = std::max(target - 1, 1);
+  int secondPassCuts = std::max(maxColors - 1, 1);
+  int remaining =
+      firstPassCuts - replay(0, firstPassEnd, firstPassCuts);
+  if (remaining > 0) {
+    std::sort(pqueue.begin(), pqueue.end(), compareByCount);
+    iterate<SIGNAL_BITS>(pqueue, compareByCount, remaining + 1, bins, token,
+                         &cuts);
+  }
+
+  remaining = secondPassCuts -
+              replay(firstPassEnd, previous.size(), secondPassCuts);
+  std::sort(pqueue.begin(), pqueue.end(), compareByProduct);
+  if (remaining > 0) {
+    iterate<SIGNAL_BITS>(pqueue, compareByProduct, remaining + 1, bins, token,
+                         &cuts);
+  }
+  std::reverse(pqueue.begin(), pqueue.end());
+
+  MMCQ::ColorMap colorMap;
+  for (const auto& vbox : pqueue) {
+    colorMap.push(vbox);
+  }
+  return std::make_unique<ColorMap>(colorMap);
 }
 
-std::pair<std::vector<int, std::allocator<int>>, MMCQ::VBox>
-MMCQ::makeHistogramAndBox(
-    const std::vector<uint8_t, std::allocator<uint8_t>>& pixels, int quality,
-    bool ignoreWhite) {
-  std::vector<int> histogram(HISTOGRAM_SIZE, 0);
+MMCQ::Histogram MMCQ::makeHistogram(const std::vector<uint8_t>& pixels,
+                                    int quality, bool ignoreWhite,
+                                    const CancellationToken* token) {
+  return makeHistogramAndBox(pixels, quality, ignoreWhite, token);
+}
+
+std::unique_ptr<MMCQ::ColorMap> MMCQ::makeExactColorMap(
+    const uint8_t* pixels, size_t size, int maxColors, int quality,
+    bool ignoreWhite, const CancellationToken* token) {
+  if (pixels == nullptr || size % 4 != 0 || size < 4) {
+    return nullptr;
+  }
+
+  // Open addressing on packed 0xRRGGBB keys; the table is at least twice
+  // the largest palette, so probes stay short until the bailout.
+  std::array<uint32_t, EXACT_TABLE_SIZE> keys;
+  std::array<int, EXACT_TABLE_SIZE> counts{};
+  keys.fill(EMPTY_KEY);
+  int uniqueCount = 0;
+
+  size_t pixelCount = size / 4;
+  size_t sampled = 0;
+  for (size_t i = 0; i < pixelCount; i += 4 * quality) {
+    if (token && ++sampled % CANCELLATION_INTERVAL == 0) {
+      token->throwIfCancelled();
+    }
+
+    const uint8_t* pixel = &pixels[i * 4];
+    if (isIgnoredPixel(pixel[0], pixel[1], pixel[2], pixel[3], ignoreWhite)) {
+      continue;
+    }
+
+    uint32_t key = (static_cast<uint32_t>(pixel[0]) << 16) |
+                   (static_cast<uint32_t>(pixel[1]) << 8) | pixel[2];
+    size_t slot = (key * 2654435761u) >> (32 - EXACT_TABLE_BITS);
+    while (keys[slot] != key && keys[slot] != EMPTY_KEY) {
+      slot = (slot + 1) & (EXACT_TABLE_SIZE - 1);
+    }
+    if (keys[slot] == EMPTY_KEY) {
+      if (++uniqueCount > maxColors) {
+        return nullptr;
+      }
+      keys[slot] = key;
+    }
+    counts[slot]++;
+  }
+
+  if (uniqueCount == 0) {
+    return nullptr;
+  }
+
+  // Each color becomes a single-bin box whose average is the color itself.
+  std::vector<VBox> vboxes;
+  vboxes.reserve(uniqueCount);
+  for (size_t slot = 0; slot < EXACT_TABLE_SIZE; slot++) {
+    if (keys[slot] == EMPTY_KEY) {
+      continue;
+    }
+    Color color(static_cast<uint8_t>(keys[slot] >> 16),
+                static_cast<uint8_t>(keys[slot] >> 8),
+                static_cast<uint8_t>(keys[slot]));
+    uint8_t r = color.r >> RIGHT_SHIFT;
+    uint8_t g = color.g >> RIGHT_SHIFT;
+    uint8_t b = color.b >> RIGHT_SHIFT;
+    VBox vbox{r, r, g, g, b, b, {0, 0}, counts[slot], 1, color};
+    vboxes.push_back(vbox);
+  }
+
+  std::stable_sort(vboxes.begin(), vboxes.end(),
+                   [](const VBox& a, const VBox& b) {
+                     if (a.count != b.count) {
+                       return a.count > b.count;
+                     }
+                     return makeColorIndexOf(a.average.r, a.average.g,
+                                             a.average.b) <
+                            makeColorIndexOf(b.average.r, b.average.g,
+                                             b.average.b);
+                   });
+
+  auto colorMap = std::make_unique<ColorMap>();
+  for (const auto& vbox : vboxes) {
+    colorMap->push(vbox);
+  }
+  return colorMap;
+}
+
+MMCQ::Histogram MMCQ::makeEmptyHistogram() {
+  return {std::vector<int>(HISTOGRAM_SIZE, 0),
+          std::numeric_limits<uint8_t>::max(),
+          std::numeric_limits<uint8_t>::min(),
+          std::numeric_limits<uint8_t>::max(),
+          std::numeric_limits<uint8_t>::min(),
+          std::numeric_limits<uint8_t>::max(),
+          std::numeric_limits<uint8_t>::min()};
+}
+
+void MMCQ::fitBounds(Histogram& histogram) {
+  constexpr int mask = (1 << SIGNAL_BITS) - 1;
   uint8_t rMin = std::numeric_limits<uint8_t>::max();
   uint8_t gMin = std::numeric_limits<uint8_t>::max();
   uint8_t bMin = std::numeric_limits<uint8_t>::max();
   uint8_t rMax = std::numeric_limits<uint8_t>::min();
   uint8_t gMax = std::numeric_limits<uint8_t>::min();
-  uint8_t bmax = std::numeric_limits<uint8_t>::min();
+  uint8_t bMax = std::numeric_limits<uint8_t>::min();
+  for (int index = 0; index < HISTOGRAM_SIZE; index++) {
+    if (histogram.counts[index] == 0) {
+      continue;
+    }
+    auto r = static_cast<uint8_t>(index >> (2 * SIGNAL_BITS));
+    auto g = static_cast<uint8_t>((index >> SIGNAL_BITS) & mask);
+    auto b = static_cast<uint8_t>(index & mask);
+    rMin = std::min(rMin, r);
+    rMax = std::max(rMax, r);
+    gMin = std::min(gMin, g);
+    gMax = std::max(gMax, g);
+    bMin = std::min(bMin, b);
+    bMax = std::max(bMax, b);
+  }
+  histogram.rMin = rMin;
+  histogram.rMax = rMax;
+  histogram.gMin = gMin;
+  histogram.gMax = gMax;
+  histogram.bMin = bMin;
+  histogram.bMax = bMax;
+}
 
+MMCQ::Histogram MMCQ::makeHistogramAndBox(
+    const std::vector<uint8_t, std::allocator<uint8_t>>& pixels, int quality,
+    bool ignoreWhite, const CancellationToken* token) {
   if (pixels.size() % 4 != 0 || pixels.size() < 4) {
     throw std::runtime_error("Invalid pixel data");
   }
 
+  Histogram histogram = makeEmptyHistogram();
   size_t pixelCount = pixels.size() / 4;
+  size_t sampled = 0;
   for (size_t i = 0; i < pixelCount; i += 4 * quality) {
+    if (token && ++sampled % CANCELLATION_INTERVAL == 0) {
+      token->throwIfCancelled();
+    }
+
     const uint8_t* pixel = &pixels[i * 4];
     uint8_t r = pixel[0];
     uint8_t g = pixel[1];
     uint8_t b = pixel[2];
     uint8_t a = pixel[3];
 
-    if (a <= 125 || (ignoreWhite && r > 250 && g > 250 && b > 250)) {
+    if (isIgnoredPixel(r, g, b, a, ignoreWhite)) {
       continue;
     }
 
-    uint8_t shiftedR = r >> RIGHT_SHIFT;
-    uint8_t shiftedG = g >> RIGHT_SHIFT;
-    uint8_t shiftedB = b >> RIGHT_SHIFT;
+    addSample(histogram, r, g, b);
+  }
+
+  fitBounds(histogram);
+  return histogram;
+}
 
-    rMin = std::min(rMin, shiftedR);
-    gMin = std::min(gMin, shiftedG);
-    bMin = std::min(bMin, shiftedB);
-    rMax = std::max(rMax, shiftedR);
-    gMax = std::max(gMax, shiftedG);
-    bmax = std::max(bmax, shiftedB);
+std::vector<MMCQ::Bin> MMCQ::makeOccupiedBins(
+    const std::vector<int>& histogram) {
+  std::vector<Bin> bins;
+  for (int index = 0; index < HISTOGRAM_SIZE; index++) {
+    if (histogram[index] != 0) {
+      bins.push_back({index, histogram[index]});
+    }
+  }
+  return bins;
+}
 
-    int index =
-        makeColorIndexOf(static_cast<int>(shiftedR), static_cast<int>(shiftedG),
-                         static_cast<int>(shiftedB));
+std::vector<MMCQ::Bin> MMCQ::makeRefinedBins(
+    const std::vector<uint8_t>& pixels, int quality, bool ignoreWhite,
+    const CancellationToken* token) {
+  constexpr int coarseShift = 8 - COARSE_SIGNAL_BITS;
+  constexpr int fineShift = 8 - FINE_SIGNAL_BITS;
+  constexpr int cellMask = (1 << CELL_BITS) - 1;
 
-    histogram[index]++;
+  if (pixels.size() % 4 != 0 || pixels.size() < 4) {
+    throw std::runtime_error("Invalid pixel data");
   }
 
-  MMCQ::VBox vbox(rMin, rMax, gMin, gMax, bMin, bmax, histogram);
-  return {histogram, vbox};
+  size_t pixelCount = pixels.size() / 4;
+  auto forEachSample = [&](auto&& visit) {
+    size_t sampled = 0;
+    for (size_t i = 0; i < pixelCount; i += 4 * quality) {
+      if (token && ++sampled % CANCELLATION_INTERVAL == 0) {
+        token->throwIfCancelled();
+      }
+
+      const uint8_t* pixel = &pixels[i * 4];
+      if (!isIgnoredPixel(pixel[0], pixel[1], pixel[2], pixel[3],
+                          ignoreWhite)) {
+        visit(pixel[0], pixel[1], pixel[2]);
+      }
+    }
+  };
+  auto makeCellOf = [](uint8_t r, uint8_t g, uint8_t b) {
+    return ((r >> coarseShift) << (2 * COARSE_SIGNAL_BITS)) |
+           ((g >> coarseShift) << COARSE_SIGNAL_BITS) | (b >> coarseShift);
+  };
+
+  std::vector<int> coarse(COARSE_HISTOGRAM_SIZE, 0);
+  forEachSample([&](uint8_t r, uint8_t g, uint8_t b) {
+    coarse[makeCellOf(r, g, b)]++;
+  });
+
+  std::vector<int> cells;
+  for (int cell = 0; cell < COARSE_HISTOGRAM_SIZE; cell++) {
+    if (coarse[cell] != 0) {
+      cells.push_back(cell);
+    }
+  }
+  if (static_cast<int>(cells.size()) > MAX_REFINED_CELLS) {
+    std::nth_element(cells.begin(), cells.begin() + MAX_REFINED_CELLS,
+                     cells.end(), [&](int a, int b) {
+                       return coarse[a] != coarse[b] ? coarse[a] > coarse[b]
+                                                     : a < b;
+                     });
+    cells.resize(MAX_REFINED_CELLS);
+  }
+
+  // Each refined cell gets a slice of one arena; -1 marks a cell that is
+  // not refined.
+  std::vector<int> offsetOfCell(COARSE_HISTOGRAM_SIZE, -1);
+  for (size_t i = 0; i < cells.size(); i++) {
+    offsetOfCell[cells[i]] = static_cast<int>(i) * CELL_SIZE;
+  }
+  std::vector<int> arena(cells.size() * CELL_SIZE, 0);
+  forEachSample([&](uint8_t r, uint8_t g, uint8_t b) {
+    int offset = offsetOfCell[makeCellOf(r, g, b)];
+    if (offset >= 0) {
+      arena[offset + ((((r >> fineShift) & cellMask) << (2 * CELL_BITS)) |
+                      (((g >> fineShift) & cellMask) << CELL_BITS) |
+                      ((b >> fineShift) & cellMask))]++;
+    }
+  });
+
+  auto makeFineIndexOf = [](int r, int g, int b) {
+    return (r << (2 * FINE_SIGNAL_BITS)) | (g << FINE_SIGNAL_BITS) | b;
+  };
+  std::vector<Bin> bins;
+  for (int cell = 0; cell < COARSE_HISTOGRAM_SIZE; cell++) {
+    if (coarse[cell] == 0) {
+      continue;
+    }
+    int r = (cell >> (2 * COARSE_SIGNAL_BITS)) << CELL_BITS;
+    int g = ((cell >> COARSE_SIGNAL_BITS) & ((1 << COARSE_SIGNAL_BITS) - 1))
+            << CELL_BITS;
+    int b = (cell & ((1 << COARSE_SIGNAL_BITS) - 1)) << CELL_BITS;
+    int offset = offsetOfCell[cell];
+    if (offset < 0) {
+      constexpr int center = 1 << (CELL_BITS - 1);
+      bins.push_back(
+          {makeFineIndexOf(r + center, g + center, b + center), coarse[cell]});
+      continue;
+    }
+    for (int sub = 0; sub < CELL_SIZE; sub++) {
+      if (arena[offset + sub] != 0) {
+        bins.push_back({makeFineIndexOf(r + (sub >> (2 * CELL_BITS)),
+                                        g + ((sub >> CELL_BITS) & cellMask),
+                                        b + (sub & cellMask)),
+                        arena[offset + sub]});
+      }
+    }
+  }
+  std::sort(bins.begin(), bins.end(),
+            [](const Bin& a, const Bin& b) { return a.index < b.index; });
+  return bins;
 }
 
-std::vector<MMCQ::VBox, std::allocator<MMCQ::VBox>> MMCQ::applyMedianCut(
-    const std::vector<int, std::allocator<int>>& histogram, const VBox& vbox) {
-  if (vbox.getCount() == 0) {
-    return {};
+template <int Bits>
+int MMCQ::makeChannelOf(int index, ColorChannel axis) {
+  constexpr int mask = (1 << Bits) - 1;
+  switch (axis) {
+    case ColorChannel::R:
+      return (index >> (2 * Bits)) & mask;
+    case ColorChannel::G:
+      return (index >> Bits) & mask;
+    case ColorChannel::B:
+    default:
+      return index & mask;
   }
+}
 
-  if (vbox.getCount() == 1) {
-    return {vbox};
+template <int Bits>
+void MMCQ::makeSliceSum(const std::vector<Bin>& bins, VBox::Range range,
+                        ColorChannel axis, SliceSum<Bits>& sliceSum) {
+  // Project the occupied bins of the box onto the cut axis.
+  int slabCount = (range.end - range.begin + SLAB_SIZE - 1) / SLAB_SIZE;
+  if (slabCount <= 1) {
+    for (int i = range.begin; i < range.end; i++) {
+      sliceSum[makeChannelOf<Bits>(bins[i].index, axis)] += bins[i].count;
+    }
+    return;
+  }
+
+  std::vector<SliceSum<Bits>> slabSums(slabCount);
+  ThreadPool::shared().parallelFor(slabCount, [&](size_t slab) {
+    int begin = range.begin + static_cast<int>(slab) * SLAB_SIZE;
+    int end = std::min(begin + SLAB_SIZE, range.end);
+    SliceSum<Bits>& slabSum = slabSums[slab];
+    for (int i = begin; i < end; i++) {
+      slabSum[makeChannelOf<Bits>(bins[i].index, axis)] += bins[i].count;
+    }
+  });
+  for (const auto& slabSum : slabSums) {
+    for (size_t i = 0; i < sliceSum.size(); i++) {
+      sliceSum[i] += slabSum[i];
+    }
+  }
+}
+
+template <int Bits>
+int MMCQ::applyMedianCut(std::vector<Bin>& bins, const VBox& vbox,
+                         VBox (&result)[2]) {
+  if (vbox.count == 0) {
+    return 0;
+  }
+
+  if (vbox.count == 1) {
+    result[0] = vbox;
+    return 1;
   }
 
-  int total = 0;
-  std::vector<int> partialSum(VBOX_LENGTH, -1);
   ColorChannel axis = vbox.widestColorChannel();
   int vboxMin;
   int vboxMax;
@@ -299,66 +688,105 @@ std::vector<MMCQ::VBox, std::allocator<MMCQ::VBox>> MMCQ::applyMedianCut(
     case ColorChannel::R:
       vboxMin = vbox.rMin;
       vboxMax = vbox.rMax;
-      for (int i = vbox.rMin; i <= vbox.rMax; i++) {
-        int sum = 0;
-        for (int j = vbox.gMin; j <= vbox.gMax; j++) {
-          for (int k = vbox.bMin; k <= vbox.bMax; k++) {
-            int index = makeColorIndexOf(i, j, k);
-            sum += histogram[index];
-          }
-        }
-        total += sum;
-        partialSum[i] = total;
-      }
       break;
     case ColorChannel::G:
       vboxMin = vbox.gMin;
       vboxMax = vbox.gMax;
-      for (int i = vbox.gMin; i <= vbox.gMax; i++) {
-        int sum = 0;
-        for (int j = vbox.rMin; j <= vbox.rMax; j++) {
-          for (int k = vbox.bMin; k <= vbox.bMax; k++) {
-            int index = makeColorIndexOf(j, i, k);
-            sum += histogram[index];
-          }
-        }
-        total = sum;
-        partialSum[i] = total;
-      }
       break;
     case ColorChannel::B:
+    default:
       vboxMin = vbox.bMin;
       vboxMax = vbox.bMax;
-      for (int i = vbox.bMin; i <= vbox.bMax; i++) {
-        int sum = 0;
-        for (int j = vbox.rMin; j <= vbox.rMax; j++) {
-          for (int k = vbox.gMin; k <= vbox.gMax; k++) {
-            int index = makeColorIndexOf(j, k, i);
-            sum += histogram[index];
-          }
-        }
-        total = sum;
-        partialSum[i] = total;
-      }
-      break;
-    default:
       break;
   }
 
-  std::vector<int> lookAheadSum(VBOX_LENGTH, -1);
+  SliceSum<Bits> sliceSum{};
+  makeSliceSum<Bits>(bins, vbox.range, axis, sliceSum);
+
+  int total = 0;
+  SliceSum<Bits> partialSum;
+  partialSum.fill(-1);
+  for (int i = vboxMin; i <= vboxMax; i++) {
+    total += sliceSum[i];
+    partialSum[i] = total;
+  }
+
+  SliceSum<Bits> lookAheadSum;
+  lookAheadSum.fill(-1);
   for (int i = vboxMin; i < vboxMax; i++) {
     if (partialSum[i] != -1) {
       lookAheadSum[i] = total - partialSum[i];
     }
   }
 
-  return cut(axis, vbox, partialSum, lookAheadSum, total);
+  return cut<Bits>(axis, vbox, partialSum, lookAheadSum, total, bins,
+                   result);
 }
 
-std::vector<MMCQ::VBox> MMCQ::cut(ColorChannel axis, const VBox& vbox,
-                                  const std::vector<int>& partialSum,
-                                  const std::vector<int>& lookAheadSum,
-                                  int total) {
+int MMCQ::replayCut(std::vector<Bin>& bins, const VBox& vbox,
+                    const Cut& previous, float tolerance,
+                    VBox (&result)[2]) {
+  const VBox& parent = previous.parent;
+  const VBox& low = previous.children[0];
+  if (vbox.count < 2 || low.count == 0 || previous.children[1].count == 0) {
+    return 0;
+  }
+
+  // The lower child keeps the parent's bounds except below the plane.
+  ColorChannel axis;
+  int plane;
+  if (low.rMax != parent.rMax) {
+    axis = ColorChannel::R;
+    plane = low.rMax;
+  } else if (low.gMax != parent.gMax) {
+    axis = ColorChannel::G;
+    plane = low.gMax;
+  } else {
+    axis = ColorChannel::B;
+    plane = low.bMax;
+  }
+
+  auto middle = std::partition(
+      bins.begin() + vbox.range.begin, bins.begin() + vbox.range.end,
+      [axis, plane](const Bin& bin) {
+        return makeChannelOf<SIGNAL_BITS>(bin.index, axis) <= plane;
+      });
+  int split = static_cast<int>(middle - bins.begin());
+  if (split == vbox.range.begin || split == vbox.range.end) {
+    return 0;
+  }
+
+  uint8_t rMax1 = vbox.rMax, gMax1 = vbox.gMax, bMax1 = vbox.bMax;
+  uint8_t rMin2 = vbox.rMin, gMin2 = vbox.gMin, bMin2 = vbox.bMin;
+  switch (axis) {
+    case ColorChannel::R:
+      rMax1 = static_cast<uint8_t>(plane);
+      rMin2 = static_cast<uint8_t>(plane + 1);
+      break;
+    case ColorChannel::G:
+      gMax1 = static_cast<uint8_t>(plane);
+      gMin2 = static_cast<uint8_t>(plane + 1);
+      break;
+    case ColorChannel::B:
+      bMax1 = static_cast<uint8_t>(plane);
+      bMin2 = static_cast<uint8_t>(plane + 1);
+      break;
+  }
+  result[0] = makeVBox<SIGNAL_BITS>(bins, vbox.rMin, rMax1, vbox.gMin, gMax1,
+                                    vbox.bMin, bMax1, {vbox.range.begin, split});
+  result[1] = makeVBox<SIGNAL_BITS>(bins, rMin2, vbox.rMax, gMin2, vbox.gMax,
+                                    bMin2, vbox.bMax, {split, vbox.range.end});
+
+  float share = static_cast<float>(result[0].count) / vbox.count;
+  float previousShare = static_cast<float>(low.count) / parent.count;
+  return std::abs(share - previousShare) <= tolerance ? 2 : 0;
+}
+
+template <int Bits>
+int MMCQ::cut(ColorChannel axis, const VBox& vbox,
+              const SliceSum<Bits>& partialSum,
+              const SliceSum<Bits>& lookAheadSum, int total,
+              std::vector<Bin>& bins, VBox (&result)[2]) {
   int vboxMin;
   int vboxMax;
 
@@ -372,6 +800,7 @@ std::vector<MMCQ::VBox> MMCQ::cut(ColorChannel axis, const VBox& vbox,
       vboxMax = static_cast<int>(vbox.gMax);
       break;
     case ColorChannel::B:
+    default:
       vboxMin = static_cast<int>(vbox.bMin);
       vboxMax = static_cast<int>(vbox.bMax);
       break;
@@ -379,9 +808,6 @@ std::vector<MMCQ::VBox> MMCQ::cut(ColorChannel axis, const VBox& vbox,
 
   for (int i = vboxMin; i <= vboxMax; i++) {
     if (partialSum[i] > total / 2) {
-      MMCQ::VBox vbox1(vbox);
-      MMCQ::VBox vbox2(vbox);
-
       int left = i - vboxMin;
       int right = vboxMax - i;
 
@@ -401,53 +827,135 @@ std::vector<MMCQ::VBox> MMCQ::cut(ColorChannel axis, const VBox& vbox,
         rightPartitionCount = lookAheadSum[d2];
       }
 
+      // Keep the bins of each half contiguous within the parent's slice.
+      auto middle = std::partition(
+          bins.begin() + vbox.range.begin, bins.begin() + vbox.range.end,
+          [axis, d2](const Bin& bin) {
+            return makeChannelOf<Bits>(bin.index, axis) <= d2;
+          });
+      int split = static_cast<int>(middle - bins.begin());
+
+      uint8_t rMax1 = vbox.rMax, gMax1 = vbox.gMax, bMax1 = vbox.bMax;
+      uint8_t rMin2 = vbox.rMin, gMin2 = vbox.gMin, bMin2 = vbox.bMin;
       switch (axis) {
         case ColorChannel::R:
-          vbox1.rMax = static_cast<uint8_t>(d2);
-          vbox2.rMin = static_cast<uint8_t>(d2 + 1);
+          rMax1 = static_cast<uint8_t>(d2);
+          rMin2 = static_cast<uint8_t>(d2 + 1);
           break;
         case ColorChannel::G:
-          vbox1.gMax = static_cast<uint8_t>(d2);
-          vbox2.gMin = static_cast<uint8_t>(d2 + 1);
+          gMax1 = static_cast<uint8_t>(d2);
+          gMin2 = static_cast<uint8_t>(d2 + 1);
           break;
         case ColorChannel::B:
-          vbox1.bMax = static_cast<uint8_t>(d2);
-          vbox2.bMin = static_cast<uint8_t>(d2 + 1);
+          bMax1 = static_cast<uint8_t>(d2);
+          bMin2 = static_cast<uint8_t>(d2 + 1);
           break;
       }
 
-      return {vbox1, vbox2};
+      result[0] = makeVBox<Bits>(bins, vbox.rMin, rMax1, vbox.gMin, gMax1,
+                                 vbox.bMin, bMax1, {vbox.range.begin, split});
+      result[1] = makeVBox<Bits>(bins, rMin2, vbox.rMax, gMin2, vbox.gMax,
+                                 bMin2, vbox.bMax, {split, vbox.range.end});
+      return 2;
     }
   }
-  return {};
+  return 0;
 }
 
+template <int Bits>
+void MMCQ::prefetchSplits(std::vector<Bin>& bins,
+                          const std::vector<VBox>& queue, int count,
+                          std::vector<Split>& splits) {
+  // Boxes at the back of the queue are the next ones iterate pops. Their bin
+  // slices are disjoint, so they can be split concurrently; a split only
+  // depends on the box itself, so using it later gives the serial result.
+  std::vector<Split> pending;
+  for (auto it = queue.rbegin();
+       it != queue.rend() && static_cast<int>(pending.size()) < count; ++it) {
+    if (it->count <= 1) {
+      continue;
+    }
+    bool known = std::any_of(splits.begin(), splits.end(),
+                             [&](const Split& split) {
+                               return split.vbox.range.begin ==
+                                          it->range.begin &&
+                                      split.vbox.range.end == it->range.end;
+                             });
+    if (!known) {
+      pending.push_back({*it, 0, {}});
+    }
+  }
+
+  ThreadPool::shared().parallelFor(pending.size(), [&](size_t i) {
+    pending[i].size =
+        applyMedianCut<Bits>(bins, pending[i].vbox, pending[i].result);
+  });
+  splits.insert(splits.end(), pending.begin(), pending.end());
+}
+
+int MMCQ::takeSplit(std::vector<Split>& splits, const VBox& vbox,
+                    VBox (&result)[2]) {
+  for (auto it = splits.begin(); it != splits.end(); ++it) {
+    if (it->vbox.range.begin == vbox.range.begin &&
+        it->vbox.range.end == vbox.range.end) {
+      result[0] = it->result[0];
+      result[1] = it->result[1];
+      int size = it->size;
+      splits.erase(it);
+      return size;
+    }
+  }
+  return -1;
+}
+
+template <int Bits>
 void MMCQ::iterate(std::vector<VBox>& queue,
                    bool (*comparator)(const VBox&, const VBox&), int target,
-                   const std::vector<int>& histogram) {
+                   std::vector<Bin>& bins, const CancellationToken* token,
+                   std::vector<Cut>* cuts) {
   int color = 1;
+  VBox vboxes[2];
+  std::vector<Split> splits;
+  int lookAhead = static_cast<int>(ThreadPool::shared().size()) + 1;
+  bool parallel =
+      lookAhead > 1 && static_cast<int>(bins.size()) >= PARALLEL_BINS_THRESHOLD;
 
   for (int _ = 0; _ < MAX_ITERATIONS; _++) {
+    if (token) {
+      token->throwIfCancelled();
+    }
     if (queue.empty()) {
       return;
     }
     VBox vbox = queue.back();
 
-    if (vbox.getCount() == 0) {
+    if (vbox.count == 0) {
       std::sort(queue.begin(), queue.end(), comparator);
       continue;
     }
 
+    if (parallel) {
+      prefetchSplits<Bits>(bins, queue,
+                           std::min(lookAhead, target - color + 1), splits);
+    }
+
     queue.pop_back();
 
-    std::vector<VBox> vboxes = applyMedianCut(histogram, vbox);
-    if (vboxes.empty()) {
+    int size = takeSplit(splits, vbox, vboxes);
+    if (size < 0) {
+      size = applyMedianCut<Bits>(bins, vbox, vboxes);
+    }
+    if (size == 0) {
       continue;
     };
     queue.push_back(vboxes[0]);
-    if (vboxes.size() == 2) {
+    if (size == 2) {
       queue.push_back(vboxes[1]);
       color++;
+      if (cuts) {
+        cuts->push_back(
+            {vbox, {vboxes[0], vboxes[1]}, comparator == compareByCount});
+      }
     }
 
     std::sort(queue.begin(), queue.end(), comparator);
@@ -459,14 +967,14 @@ void MMCQ::iterate(std::vector<VBox>& queue,
 }
 
 bool MMCQ::compareByCount(const VBox& a, const VBox& b) {
-  return a.getCount() < b.getCount();
+  return a.count < b.count;
 }
 
 bool MMCQ::compareByProduct(const VBox& a, const VBox& b) {
-  int aCount = a.getCount();
-  int bCount = b.getCount();
-  int aVolume = a.getVolume();
-  int bVolume = b.getVolume();
+  int aCount = a.count;
+  int bCount = b.count;
+  int aVolume = a.volume;
+  int bVolume = b.volume;
 
   if (aCount == bCount) {
     return aVolume < bVolume;
@@ -1,14 +1,23 @@
 #ifndef MMCQ_HPP
 #define MMCQ_HPP
 
+#include <algorithm>
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <type_traits>
 #include <NitroModules/ArrayBuffer.hpp>
 #include <iostream>
+#include "CancellationToken.hpp"
 
 class MMCQ {
  public:
+  static constexpr int SIGNAL_BITS = 5;
+  static constexpr int RIGHT_SHIFT = 8 - SIGNAL_BITS;
+  static constexpr int HISTOGRAM_SIZE = 1 << (3 * SIGNAL_BITS);
+
   struct Color {
     uint8_t r;
     uint8_t g;
@@ -22,33 +31,41 @@ class MMCQ {
 
   enum ColorChannel { R, G, B };
 
-  class VBox {
-   public:
+  struct Bin {
+    int index;
+    int count;
+  };
+
+  // Plain box value: bounds plus the count, volume and average cached when
+  // the box is made. Boxes are sorted and split by value.
+  struct VBox {
     struct Range {
       int begin;
       int end;
     };
 
-    VBox(uint8_t rMin, uint8_t rMax, uint8_t gMin, uint8_t gMax, uint8_t bMin,
-         uint8_t bMax, std::vector<int>& histogram);
-    VBox(const VBox& vbox);
-    VBox& operator=(const VBox& other);
-    VBox& operator=(VBox&& other) noexcept = default;
-
-    int getVolume(bool forceRecalculation = false) const;
-    int getCount(bool forceRecalculation = false) const;
-    Color getAverage(bool forceRecalculation = false) const;
     ColorChannel widestColorChannel() const;
 
     uint8_t rMin, rMax;
     uint8_t gMin, gMax;
     uint8_t bMin, bMax;
 
-   private:
-    std::shared_ptr<std::vector<int>> histogram;
-    mutable std::optional<Color> average;
-    mutable std::optional<int> volume;
-    mutable std::optional<int> count;
+    // Slice of the quantization's occupied-bin list that lies inside this
+    // box. Cuts partition the slice in place so each box's bins stay
+    // contiguous.
+    Range range;
+    int count;
+    int volume;
+    Color average;
+  };
+
+  // Pixel counts at SIGNAL_BITS per channel, along with the bounds of the
+  // sampled colors.
+  struct Histogram {
+    std::vector<int> counts;
+    uint8_t rMin, rMax;
+    uint8_t gMin, gMax;
+    uint8_t bMin, bMax;
   };
 
   class ColorMap {
@@ -61,45 +78,207 @@ class MMCQ {
     std::vector<Color> makePalette() const;
     Color makeNearestColor(const Color& color) const;
     void push(const VBox& vbox);
+    const std::vector<VBox>& getVBoxes() const;
 
    private:
     std::vector<VBox> vboxes;
   };
 
-  static std::unique_ptr<ColorMap> quantize(const std::vector<uint8_t>& pixels,
-                                            int maxColors, int quality,
-                                            bool ignoreWhite);
+  // Orders boxes by count times volume, then by volume. quantize returns
+  // its boxes in the reverse of this order.
+  static bool compareByProduct(const VBox& a, const VBox& b);
+
+  // One median cut: the box that was split and the two boxes it became.
+  struct Cut {
+    VBox parent;
+    VBox children[2];
+    // Made by the first pass, which cuts the most populated box.
+    bool byPopulation;
+  };
+
+  // A cancelled token makes quantize throw CancelledError at the next
+  // sampling block or cut.
+  static std::unique_ptr<ColorMap> quantize(
+      const std::vector<uint8_t>& pixels, int maxColors, int quality,
+      bool ignoreWhite, const CancellationToken* token = nullptr);
+
+  static std::unique_ptr<ColorMap> quantize(
+      const Histogram& histogram, int maxColors,
+      const CancellationToken* token = nullptr);
+
+  // Cuts a histogram given as its occupied bins, sorted by index.
+  static std::unique_ptr<ColorMap> quantize(
+      std::vector<Bin> bins, int maxColors,
+      const CancellationToken* token = nullptr);
+
+  // Quantizes through the histogram, skipping the exact-color shortcut, and
+  // appends every cut made to cuts in the order it was made.
+  static std::unique_ptr<ColorMap> quantizeWithCuts(
+      const std::vector<uint8_t>& pixels, int maxColors, int quality,
+      bool ignoreWhite, std::vector<Cut>& cuts,
+      const CancellationToken* token = nullptr);
+
+  // Cuts a histogram starting from the cuts of an earlier quantization, as
+  // recorded by quantizeWithCuts or by this function. Each earlier cut is
+  // replayed at its split plane while the share of its box's population
+  // falling on either side has moved by at most tolerance; a cut that drifted
+  // further is dropped with every cut below it, and the boxes left are cut
+  // afresh. Appends every cut of the result to cuts.
+  static std::unique_ptr<ColorMap> quantizeFromCuts(
+      const Histogram& histogram, int maxColors,
+      const std::vector<Cut>& previous, float tolerance,
+      std::vector<Cut>& cuts, const CancellationToken* token = nullptr);
+
+  // Cuts at FINE_SIGNAL_BITS instead of SIGNAL_BITS. A coarse histogram
+  // finds where the colors are, and only its most populated cells are
+  // counted at the finer resolution, so memory and scan cost stay close to
+  // the coarse level while cuts inside color clusters are near exact.
+  static std::unique_ptr<ColorMap> quantizeRefined(
+      const std::vector<uint8_t>& pixels, int maxColors, int quality,
+      bool ignoreWhite, const CancellationToken* token = nullptr);
+
+  // Samples pixels the way quantize does, without cutting.
+  static Histogram makeHistogram(const std::vector<uint8_t>& pixels,
+                                 int quality, bool ignoreWhite,
+                                 const CancellationToken* token = nullptr);
+
+  static int makeColorIndexOf(int red, int green, int blue) {
+    return (red << (2 * SIGNAL_BITS)) + (green << SIGNAL_BITS) + blue;
+  }
+
+  // Counts the sampled colors exactly, giving up once there are more than
+  // maxColors of them. Returns nullptr when the image needs quantizing.
+  static std::unique_ptr<ColorMap> makeExactColorMap(
+      const uint8_t* pixels, size_t size, int maxColors, int quality,
+      bool ignoreWhite, const CancellationToken* token = nullptr);
+
+  // A histogram with no samples, its bounds inverted until the first one.
+  static Histogram makeEmptyHistogram();
+
+  // The one binning step every sampler shares: counts the color in its bin.
+  // The bounds are left to fitBounds, once sampling is done.
+  static void addSample(Histogram& histogram, uint8_t r, uint8_t g,
+                        uint8_t b) {
+    histogram.counts[makeColorIndexOf(r >> RIGHT_SHIFT, g >> RIGHT_SHIFT,
+                                      b >> RIGHT_SHIFT)]++;
+  }
+
+  // Shrinks the bounds to the occupied bins. Scanning the bins once is
+  // cheaper than widening the bounds per sample, which keeps them in memory
+  // through the sampling loop.
+  static void fitBounds(Histogram& histogram);
+
+  // Pixels that are mostly transparent, or white when ignoreWhite is set,
+  // are left out of every histogram.
+  static bool isIgnoredPixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+                             bool ignoreWhite) {
+    return a <= 125 || (ignoreWhite && r > 250 && g > 250 && b > 250);
+  }
 
  private:
-  static constexpr int SIGNAL_BITS = 5;
-  static constexpr int RIGHT_SHIFT = 8 - SIGNAL_BITS;
-  static constexpr int MULTIPLIER = 1 << RIGHT_SHIFT;
-  static constexpr int HISTOGRAM_SIZE = 1 << (3 * SIGNAL_BITS);
-  static constexpr int VBOX_LENGTH = 1 << SIGNAL_BITS;
   static constexpr double FRACTION_BY_POPULATION = 0.75;
   static constexpr int MAX_ITERATIONS = 1000;
-  static constexpr int MASK = (1 << SIGNAL_BITS) - 1;
+  // Histograms with fewer occupied bins than this are cut serially.
+  static constexpr int PARALLEL_BINS_THRESHOLD = 4096;
+  // Sampled pixels between two cancellation checks.
+  static constexpr size_t CANCELLATION_INTERVAL = 16384;
+  // Number of bins each task projects when a box is large enough to be
+  // projected in parallel slabs.
+  static constexpr int SLAB_SIZE = 8192;
+  // Resolutions of the two levels quantizeRefined counts at.
+  static constexpr int COARSE_SIGNAL_BITS = 4;
+  static constexpr int FINE_SIGNAL_BITS = 7;
+  static constexpr int CELL_BITS = FINE_SIGNAL_BITS - COARSE_SIGNAL_BITS;
+  static constexpr int COARSE_HISTOGRAM_SIZE = 1 << (3 * COARSE_SIGNAL_BITS);
+  static constexpr int CELL_SIZE = 1 << (3 * CELL_BITS);
+  // Coarse cells refined at most, which bounds the arena at 1 MB; sparser
+  // cells are kept as one bin at their center.
+  static constexpr int MAX_REFINED_CELLS = 512;
+  // Slots in the exact-color table, at least twice the largest palette.
+  static constexpr int EXACT_TABLE_BITS = 9;
+  static constexpr size_t EXACT_TABLE_SIZE = size_t{1} << EXACT_TABLE_BITS;
+  // Marks a free slot; packed colors never set the top byte.
+  static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
 
-  static int makeColorIndexOf(int red, int green, int blue);
+  template <int Bits>
+  using SliceSum = std::array<int, 1 << Bits>;
 
-  static std::pair<std::vector<int, std::allocator<int>>, VBox>
-  makeHistogramAndBox(
+  // Split of a queued box computed ahead of time by iterate.
+  struct Split {
+    VBox vbox;
+    int size;
+    VBox result[2];
+  };
+
+  static Histogram makeHistogramAndBox(
       const std::vector<uint8_t, std::allocator<uint8_t>>& pixels, int quality,
-      bool ignoreWhite);
+      bool ignoreWhite, const CancellationToken* token);
+
+  static std::vector<Bin> makeOccupiedBins(const std::vector<int>& histogram);
 
-  static std::vector<VBox, std::allocator<VBox>> applyMedianCut(
-      const std::vector<int, std::allocator<int>>& histogram, const VBox& vbox);
+  // Occupied bins at FINE_SIGNAL_BITS, sorted by index.
+  static std::vector<Bin> makeRefinedBins(const std::vector<uint8_t>& pixels,
+                                          int quality, bool ignoreWhite,
+                                          const CancellationToken* token);
 
-  static std::vector<VBox> cut(ColorChannel axis, const VBox& vbox,
-                               const std::vector<int>& partialSun,
-                               const std::vector<int>& lookAheadSum, int total);
+  // The cut below is shared by every resolution; Bits is the signal bits
+  // per channel the bin indices are packed at.
+  template <int Bits>
+  static std::unique_ptr<ColorMap> quantizeSparse(
+      std::vector<Bin> bins, int maxColors, const CancellationToken* token);
 
+  template <int Bits>
+  static std::unique_ptr<ColorMap> quantizeBins(
+      std::vector<Bin> bins, uint8_t rMin, uint8_t rMax, uint8_t gMin,
+      uint8_t gMax, uint8_t bMin, uint8_t bMax, int maxColors,
+      const CancellationToken* token, std::vector<Cut>* cuts = nullptr);
+
+  template <int Bits>
+  static int makeChannelOf(int index, ColorChannel axis);
+
+  template <int Bits>
+  static VBox makeVBox(const std::vector<Bin>& bins, uint8_t rMin,
+                       uint8_t rMax, uint8_t gMin, uint8_t gMax, uint8_t bMin,
+                       uint8_t bMax, VBox::Range range);
+
+  template <int Bits>
+  static void makeSliceSum(const std::vector<Bin>& bins, VBox::Range range,
+                           ColorChannel axis, SliceSum<Bits>& sliceSum);
+
+  template <int Bits>
+  static int applyMedianCut(std::vector<Bin>& bins, const VBox& vbox,
+                            VBox (&result)[2]);
+
+  template <int Bits>
+  static void prefetchSplits(std::vector<Bin>& bins,
+                             const std::vector<VBox>& queue, int count,
+                             std::vector<Split>& splits);
+
+  static int takeSplit(std::vector<Split>& splits, const VBox& vbox,
+                       VBox (&result)[2]);
+
+  // Splits vbox at the plane of an earlier cut. Returns 2, or 0 when the
+  // plane leaves one side empty or moves the population split by more than
+  // tolerance.
+  static int replayCut(std::vector<Bin>& bins, const VBox& vbox,
+                       const Cut& previous, float tolerance,
+                       VBox (&result)[2]);
+
+  template <int Bits>
+  static int cut(ColorChannel axis, const VBox& vbox,
+                 const SliceSum<Bits>& partialSum,
+                 const SliceSum<Bits>& lookAheadSum, int total,
+                 std::vector<Bin>& bins, VBox (&result)[2]);
+
+  template <int Bits>
   static void iterate(std::vector<VBox>& queue,
                       bool (*comparator)(const VBox&, const VBox&), int target,
-                      const std::vector<int>& histogram);
+                      std::vector<Bin>& bins, const CancellationToken* token,
+                      std::vector<Cut>* cuts);
 
   static bool compareByCount(const VBox& a, const VBox& b);
-  static bool compareByProduct(const VBox& a, const VBox& b);
 };
 
+static_assert(std::is_trivially_copyable_v<MMCQ::VBox>);
+
 #endif
@@ -1,40 +1,699 @@
 #include <NitroModules/ArrayBuffer.hpp>
+#include <limits>
 #include "NitroPalette.hpp"
 #include "MMCQ.hpp"
+#include "CollectionQuantizer.hpp"
+#include "Dither.hpp"
+#include "ImageAnalyzer.hpp"
+#include "ImageDecoder.hpp"
+#include "ProgressiveQuantizer.hpp"
+#include "RegionQuantizer.hpp"
+#include "SplitTree.hpp"
+#include "Swatches.hpp"
+#include "ThreadPool.hpp"
+#include "YuvSampler.hpp"
 
 std::vector<std::string>
 margelo::nitro::nitropalette::NitroPalette::extractColors(
     const std::shared_ptr<ArrayBuffer>& source, double colorCount,
     double quality, bool ignoreWhite) {
-  currentImageSize_ = source->size();
-  if (!source || currentImageSize_ < 4) {
+  if (!source || source->size() < 4) {
     return {};
   }
 
-  if (currentImageSize_ % 4 != 0) {
+  if (source->size() % 4 != 0) {
     return {};
   }
 
-  colorCount = std::clamp(colorCount, 1.0, 20.0);
-  quality = std::clamp(quality, 1.0, 10.0);
-
+  auto memory = reserveMemory(source->size());
   auto pixels = reinterpret_cast<uint8_t*>(source->data());
-  std::vector<uint8_t> pixelsVector(pixels, pixels + currentImageSize_);
-
-  auto colorMap = MMCQ::quantize(pixelsVector, static_cast<int>(colorCount),
-                                 static_cast<int>(quality), ignoreWhite);
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
 
-  auto palette = colorMap->makePalette();
+  return quantizeToStrings(pixelsVector, colorCount, quality, ignoreWhite);
+}
 
-  if (palette.empty()) {
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::trackFrame(
+    const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+    bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0) {
     return {};
   }
 
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+
+  std::lock_guard<std::mutex> lock(trackerMutex_);
+  if (!tracker_ || tracker_->getMaxColors() != maxColors ||
+      tracker_->getIgnoreWhite() != ignoreWhite) {
+    tracker_ = std::make_unique<PaletteTracker>(maxColors, ignoreWhite);
+  }
+
+  auto palette = tracker_->track(reinterpret_cast<uint8_t*>(source->data()),
+                                 source->size());
+
+  return makeColorStrings(palette);
+}
+
+void margelo::nitro::nitropalette::NitroPalette::resetFrameTracking() {
+  std::lock_guard<std::mutex> lock(trackerMutex_);
+  tracker_.reset();
+}
+
+std::shared_ptr<margelo::nitro::Promise<
+    margelo::nitro::nitropalette::BudgetedPalette>>
+margelo::nitro::nitropalette::NitroPalette::extractColorsWithBudget(
+    const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+    bool ignoreWhite, double budgetMs,
+    const std::function<void(const std::vector<std::string>&)>&
+        onEarlyResult) {
+  // The buffer belongs to JS, so take a copy before leaving the JS thread.
+  std::vector<uint8_t> pixels;
+  if (source && source->size() >= 4 && source->size() % 4 == 0) {
+    auto data = reinterpret_cast<uint8_t*>(source->data());
+    pixels.assign(data, data + source->size());
+  }
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  auto memory = reserveMemory(pixels.size());
+  auto budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double, std::milli>(std::max(budgetMs, 0.0)));
+
+  return Promise<BudgetedPalette>::async(
+      [pixels = std::move(pixels), memory, maxColors, ignoreWhite, budget,
+       onEarlyResult]() -> BudgetedPalette {
+        ReleaseOnExit release{memory};
+        if (pixels.empty()) {
+          return BudgetedPalette({}, 0, true);
+        }
+
+        auto result = ProgressiveQuantizer::quantize(
+            pixels, maxColors, ignoreWhite, budget,
+            [&](const std::vector<MMCQ::Color>& palette) {
+              onEarlyResult(makeColorStrings(palette, maxColors));
+            });
+        return BudgetedPalette(makeColorStrings(result.palette, maxColors),
+                               static_cast<double>(result.pixelsUsed),
+                               result.complete);
+      });
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::makeColorStrings(
+    const std::vector<MMCQ::Color>& palette) {
   std::vector<std::string> result;
   result.reserve(palette.size());
   for (const auto& color : palette) {
     result.push_back(color.toString());
   }
+  return result;
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::makeColorStrings(
+    const std::vector<MMCQ::Color>& palette, int maxColors) {
+  size_t count = std::min(palette.size(), static_cast<size_t>(maxColors));
+  return makeColorStrings(
+      std::vector<MMCQ::Color>(palette.begin(), palette.begin() + count));
+}
+
+std::shared_ptr<margelo::nitro::Promise<std::vector<std::string>>>
+margelo::nitro::nitropalette::NitroPalette::extractColorsFromEncoded(
+    const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+    double quality, bool ignoreWhite, double maxDimension) {
+  // Encoded bytes are small next to the decoded bitmap, so copying them off
+  // the JS thread is cheap.
+  std::vector<uint8_t> encoded;
+  if (source && source->size() > 0) {
+    auto data = reinterpret_cast<uint8_t*>(source->data());
+    encoded.assign(data, data + source->size());
+  }
+  int dimension = static_cast<int>(std::clamp(maxDimension, 1.0, 4096.0));
+  auto memory = reserveMemory(encoded.size());
+
+  return Promise<std::vector<std::string>>::async(
+      [encoded = std::move(encoded), memory, colorCount, quality, ignoreWhite,
+       dimension, inFlightBytes = inFlightBytes_]() {
+        ReleaseOnExit release{memory};
+        auto image =
+            ImageDecoder::decode(encoded.data(), encoded.size(), dimension);
+        MemoryReservation decoded(inFlightBytes, image.pixels.size());
+        return quantizeToStrings(image.pixels, colorCount, quality,
+                                 ignoreWhite);
+      });
+}
+
+std::shared_ptr<margelo::nitro::Promise<std::vector<std::string>>>
+margelo::nitro::nitropalette::NitroPalette::extractColorsFromFile(
+    const std::string& path, double colorCount, double quality,
+    bool ignoreWhite, double maxDimension) {
+  int dimension = static_cast<int>(std::clamp(maxDimension, 1.0, 4096.0));
+
+  return Promise<std::vector<std::string>>::async(
+      [path, colorCount, quality, ignoreWhite, dimension,
+       inFlightBytes = inFlightBytes_]() {
+        // The file is read by the decoder itself; only the bitmap it
+        // produces is held here.
+        auto image = ImageDecoder::decodeFile(path, dimension);
+        MemoryReservation decoded(inFlightBytes, image.pixels.size());
+        return quantizeToStrings(image.pixels, colorCount, quality,
+                                 ignoreWhite);
+      });
+}
+
+double margelo::nitro::nitropalette::NitroPalette::createRequestId() {
+  return static_cast<double>(
+      nextRequestId_.fetch_add(1, std::memory_order_relaxed));
+}
+
+std::shared_ptr<margelo::nitro::Promise<std::vector<std::string>>>
+margelo::nitro::nitropalette::NitroPalette::extractColorsAsync(
+    const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+    double quality, bool ignoreWhite, double requestId, double priority) {
+  auto promise = Promise<std::vector<std::string>>::create();
+  std::vector<uint8_t> pixels;
+  if (source) {
+    auto data = reinterpret_cast<uint8_t*>(source->data());
+    pixels.assign(data, data + source->size());
+  }
+  auto memory = reserveMemory(pixels.size());
+
+  scheduler_.schedule(
+      static_cast<uint64_t>(requestId), static_cast<int>(priority),
+      [promise, pixels = std::move(pixels), memory, colorCount, quality,
+       ignoreWhite](const CancellationToken& token) {
+        std::vector<std::string> colors;
+        try {
+          colors = quantizeToStrings(pixels, colorCount, quality, ignoreWhite,
+                                     &token);
+        } catch (...) {
+          memory->release();
+          promise->reject(std::current_exception());
+          return;
+        }
+        memory->release();
+        promise->resolve(colors);
+      },
+      [promise, memory]() {
+        memory->release();
+        promise->reject(std::make_exception_ptr(CancelledError()));
+      });
+  return promise;
+}
+
+void margelo::nitro::nitropalette::NitroPalette::cancelExtraction(
+    double requestId) {
+  scheduler_.cancel(static_cast<uint64_t>(requestId));
+}
+
+void margelo::nitro::nitropalette::NitroPalette::setExtractionPriority(
+    double requestId, double priority) {
+  scheduler_.setPriority(static_cast<uint64_t>(requestId),
+                         static_cast<int>(priority));
+}
+
+std::vector<std::vector<std::string>>
+margelo::nitro::nitropalette::NitroPalette::extractRegionColors(
+    const std::shared_ptr<ArrayBuffer>& source, double width, double height,
+    double columns, double rows, double edgeFraction, double colorCount,
+    double quality, bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0 ||
+      width < 1 || height < 1) {
+    return {};
+  }
 
+  RegionQuantizer::Layout layout{
+      static_cast<int>(width), static_cast<int>(height),
+      static_cast<int>(std::clamp(columns, 1.0, 16.0)),
+      static_cast<int>(std::clamp(rows, 1.0, 16.0)),
+      std::clamp(edgeFraction, 0.0, 0.5)};
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  int sampleQuality = static_cast<int>(std::clamp(quality, 1.0, 10.0));
+
+  auto palettes = RegionQuantizer::quantize(
+      reinterpret_cast<uint8_t*>(source->data()), source->size(), layout,
+      maxColors, sampleQuality, ignoreWhite);
+
+  std::vector<std::vector<std::string>> result;
+  result.reserve(palettes.size());
+  for (const auto& palette : palettes) {
+    result.push_back(makeColorStrings(palette, maxColors));
+  }
   return result;
 }
+
+std::shared_ptr<margelo::nitro::Promise<void>>
+margelo::nitro::nitropalette::NitroPalette::indexPalettes(
+    const std::vector<std::string>& ids,
+    const std::vector<std::shared_ptr<ArrayBuffer>>& sources, double quality,
+    bool ignoreWhite) {
+  auto images = copyImages(sources);
+  auto memory = reserveMemory(images);
+  int sampleQuality = static_cast<int>(std::clamp(quality, 1.0, 10.0));
+
+  return Promise<void>::async([index = paletteIndex_, ids,
+                               images = std::move(images), memory,
+                               sampleQuality, ignoreWhite]() {
+    ReleaseOnExit release{memory};
+    if (ids.size() != images.size()) {
+      throw std::runtime_error("Every palette needs an id");
+    }
+
+    std::vector<PaletteIndex::Signature> signatures(images.size());
+    ThreadPool::shared().parallelFor(images.size(), [&](size_t i) {
+      auto colorMap = MMCQ::quantize(images[i], PaletteIndex::SIGNATURE_SIZE,
+                                     sampleQuality, ignoreWhite);
+      if (colorMap) {
+        signatures[i] = PaletteIndex::makeSignature(*colorMap);
+      }
+    });
+    index->insert(ids, signatures);
+  });
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::findSimilarPalettes(
+    const std::vector<double>& colors, double count) {
+  if (colors.empty() || count < 1) {
+    return {};
+  }
+
+  std::vector<MMCQ::Color> queryColors;
+  for (double color : colors) {
+    auto rgb = static_cast<uint32_t>(std::clamp(color, 0.0, 16777215.0));
+    queryColors.emplace_back(static_cast<uint8_t>(rgb >> 16),
+                             static_cast<uint8_t>(rgb >> 8),
+                             static_cast<uint8_t>(rgb));
+  }
+
+  auto matches = paletteIndex_->findNearest(
+      PaletteIndex::makeSignature(queryColors), static_cast<size_t>(count));
+  std::vector<std::string> ids;
+  ids.reserve(matches.size());
+  for (auto& match : matches) {
+    ids.push_back(std::move(match.id));
+  }
+  return ids;
+}
+
+std::shared_ptr<margelo::nitro::ArrayBuffer>
+margelo::nitro::nitropalette::NitroPalette::serializePaletteIndex() {
+  return makeArrayBuffer(paletteIndex_->serialize());
+}
+
+void margelo::nitro::nitropalette::NitroPalette::loadPaletteIndex(
+    const std::shared_ptr<ArrayBuffer>& data) {
+  if (!data) {
+    throw std::runtime_error("Invalid palette index data");
+  }
+  paletteIndex_->deserialize(reinterpret_cast<uint8_t*>(data->data()),
+                             data->size());
+}
+
+void margelo::nitro::nitropalette::NitroPalette::clearPaletteIndex() {
+  paletteIndex_->clear();
+}
+
+void margelo::nitro::nitropalette::NitroPalette::configureCache(
+    const std::string& directory) {
+  auto cache =
+      directory.empty() ? nullptr : std::make_shared<PaletteCache>(directory);
+  std::lock_guard<std::mutex> lock(cacheMutex_);
+  cache_ = std::move(cache);
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::getCachedColors(
+    const std::string& key, double colorCount, double quality,
+    bool ignoreWhite) {
+  auto cache = getCache();
+  if (!cache || key.empty()) {
+    return {};
+  }
+
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  uint64_t cacheKey = PaletteCache::makeKey(
+      PaletteCache::makeContentHash(
+          reinterpret_cast<const uint8_t*>(key.data()), key.size()),
+      maxColors, static_cast<int>(std::clamp(quality, 1.0, 10.0)),
+      ignoreWhite);
+  std::vector<MMCQ::Color> palette;
+  if (!cache->find(cacheKey, palette)) {
+    return {};
+  }
+  return makeColorStrings(palette, maxColors);
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::extractColorsCached(
+    const std::string& key, const std::shared_ptr<ArrayBuffer>& source,
+    double colorCount, double quality, bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0) {
+    return {};
+  }
+
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  int sampleQuality = static_cast<int>(std::clamp(quality, 1.0, 10.0));
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+
+  // Without a key the pixels themselves are hashed, which still skips the
+  // quantization.
+  auto cache = getCache();
+  uint64_t cacheKey = 0;
+  std::vector<MMCQ::Color> palette;
+  if (cache) {
+    uint64_t contentHash =
+        key.empty()
+            ? PaletteCache::makeContentHash(pixels, source->size())
+            : PaletteCache::makeContentHash(
+                  reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    cacheKey = PaletteCache::makeKey(contentHash, maxColors, sampleQuality,
+                                     ignoreWhite);
+    if (cache->find(cacheKey, palette)) {
+      return makeColorStrings(palette, maxColors);
+    }
+  }
+
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  auto colorMap =
+      MMCQ::quantize(pixelsVector, maxColors, sampleQuality, ignoreWhite);
+  if (!colorMap) {
+    return {};
+  }
+
+  palette = colorMap->makePalette();
+  if (cache) {
+    cache->store(cacheKey, palette);
+  }
+  return makeColorStrings(palette, maxColors);
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::ditherToPalette(
+    const std::shared_ptr<ArrayBuffer>& source, double width, double height,
+    double colorCount, double quality, bool ignoreWhite,
+    const std::shared_ptr<ArrayBuffer>& output) {
+  if (!source || width < 1 || height < 1 ||
+      source->size() != static_cast<size_t>(width) *
+                            static_cast<size_t>(height) * 4) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+  if (!output || output->size() != source->size()) {
+    throw std::runtime_error("Output buffer must match the source size");
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  auto colorMap = MMCQ::quantize(
+      pixelsVector, static_cast<int>(std::clamp(colorCount, 1.0, 20.0)),
+      static_cast<int>(std::clamp(quality, 1.0, 10.0)), ignoreWhite);
+  if (!colorMap) {
+    return {};
+  }
+
+  Dither::apply(pixels, static_cast<int>(width), static_cast<int>(height),
+                *colorMap, reinterpret_cast<uint8_t*>(output->data()));
+  return makeColorStrings(colorMap->makePalette());
+}
+
+std::shared_ptr<margelo::nitro::ArrayBuffer>
+margelo::nitro::nitropalette::NitroPalette::makeHistogram(
+    const std::shared_ptr<ArrayBuffer>& source, double quality,
+    bool ignoreWhite) {
+  if (!source) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  auto histogram = MMCQ::makeHistogram(
+      pixelsVector, static_cast<int>(std::clamp(quality, 1.0, 10.0)),
+      ignoreWhite);
+  return makeArrayBuffer(CollectionQuantizer::serialize(histogram));
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::extractColorsFromHistograms(
+    const std::vector<std::shared_ptr<ArrayBuffer>>& histograms,
+    const std::vector<double>& weights, double colorCount) {
+  std::vector<MMCQ::Histogram> decoded;
+  decoded.reserve(histograms.size());
+  for (const auto& histogram : histograms) {
+    if (!histogram) {
+      throw std::runtime_error("Invalid histogram data");
+    }
+    decoded.push_back(CollectionQuantizer::deserialize(
+        reinterpret_cast<uint8_t*>(histogram->data()), histogram->size()));
+  }
+
+  return quantizeHistogram(CollectionQuantizer::merge(decoded, weights),
+                           colorCount);
+}
+
+std::shared_ptr<margelo::nitro::Promise<std::vector<std::string>>>
+margelo::nitro::nitropalette::NitroPalette::extractCollectionColors(
+    const std::vector<std::shared_ptr<ArrayBuffer>>& sources,
+    const std::vector<double>& weights, double colorCount, double quality,
+    bool ignoreWhite) {
+  auto images = copyImages(sources);
+  auto memory = reserveMemory(images);
+  int sampleQuality = static_cast<int>(std::clamp(quality, 1.0, 10.0));
+
+  return Promise<std::vector<std::string>>::async(
+      [images = std::move(images), memory, weights, colorCount, sampleQuality,
+       ignoreWhite]() {
+        ReleaseOnExit release{memory};
+        auto histograms = CollectionQuantizer::makeHistograms(
+            images, sampleQuality, ignoreWhite);
+        auto merged = CollectionQuantizer::merge(histograms, weights);
+        return quantizeHistogram(merged, colorCount);
+      });
+}
+
+std::vector<margelo::nitro::nitropalette::Swatch>
+margelo::nitro::nitropalette::NitroPalette::extractSwatches(
+    const std::shared_ptr<ArrayBuffer>& source, double quality,
+    bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0) {
+    return {};
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  auto colorMap = MMCQ::quantize(
+      pixelsVector, Swatches::MAX_COLORS,
+      static_cast<int>(std::clamp(quality, 1.0, 10.0)), ignoreWhite);
+  if (!colorMap) {
+    return {};
+  }
+
+  std::vector<Swatch> swatches;
+  for (const auto& swatch : Swatches::classify(*colorMap)) {
+    swatches.emplace_back(Swatches::makeRoleName(swatch.role),
+                          swatch.color.toString(),
+                          static_cast<double>(swatch.population),
+                          swatch.titleText.toString(),
+                          swatch.bodyText.toString());
+  }
+  return swatches;
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::extractColorsRefined(
+    const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+    double quality, bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0) {
+    return {};
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  auto colorMap = MMCQ::quantizeRefined(
+      pixelsVector, maxColors, static_cast<int>(std::clamp(quality, 1.0, 10.0)),
+      ignoreWhite);
+  if (!colorMap) {
+    return {};
+  }
+
+  return makeColorStrings(colorMap->makePalette(), maxColors);
+}
+
+std::shared_ptr<margelo::nitro::ArrayBuffer>
+margelo::nitro::nitropalette::NitroPalette::makePaletteTree(
+    const std::shared_ptr<ArrayBuffer>& source, double maxColors,
+    double quality, bool ignoreWhite) {
+  if (!source || source->size() < 4 || source->size() % 4 != 0) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  auto tree = SplitTree::quantize(
+      pixelsVector, static_cast<int>(std::clamp(maxColors, 1.0, 255.0)),
+      static_cast<int>(std::clamp(quality, 1.0, 10.0)), ignoreWhite);
+  return makeArrayBuffer(tree.serialize());
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::extractColorsFromPaletteTree(
+    const std::shared_ptr<ArrayBuffer>& tree, double colorCount) {
+  if (!tree) {
+    throw std::runtime_error("Invalid palette tree data");
+  }
+
+  auto decoded = SplitTree::deserialize(
+      reinterpret_cast<uint8_t*>(tree->data()), tree->size());
+  return makeColorStrings(decoded.makePalette(
+      static_cast<int>(std::clamp(colorCount, 1.0, 255.0))));
+}
+
+margelo::nitro::nitropalette::ImageAnalysis
+margelo::nitro::nitropalette::NitroPalette::analyzeImage(
+    const std::shared_ptr<ArrayBuffer>& source, double width, double height,
+    double outputs, double colorCount, double quality, bool ignoreWhite) {
+  if (!source || width < 1 || height < 1) {
+    throw std::runtime_error("Invalid pixel data");
+  }
+
+  auto pixels = reinterpret_cast<uint8_t*>(source->data());
+  auto memory = reserveMemory(source->size());
+  std::vector<uint8_t> pixelsVector(pixels, pixels + source->size());
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  auto result = ImageAnalyzer::analyze(
+      pixelsVector.data(), pixelsVector.size(), static_cast<int>(width),
+      static_cast<int>(height),
+      static_cast<unsigned>(std::clamp(outputs, 0.0, 255.0)), maxColors,
+      static_cast<int>(std::clamp(quality, 1.0, 10.0)), ignoreWhite);
+  return ImageAnalysis(makeColorStrings(result.palette, maxColors),
+                       result.average ? result.average->toString() : "",
+                       std::move(result.luminance),
+                       std::move(result.placeholder));
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::extractColorsFromYuv(
+    const std::shared_ptr<ArrayBuffer>& y, const std::shared_ptr<ArrayBuffer>& u,
+    const std::shared_ptr<ArrayBuffer>& v, double width, double height,
+    double yRowStride, double yPixelStride, double uRowStride,
+    double uPixelStride, double uOffset, double vRowStride,
+    double vPixelStride, double vOffset, bool bt709, bool fullRange,
+    double colorCount, double quality, bool ignoreWhite) {
+  YuvSampler::Frame frame{static_cast<int>(width), static_cast<int>(height),
+                          makePlane(y, yRowStride, yPixelStride, 0),
+                          makePlane(u, uRowStride, uPixelStride, uOffset),
+                          makePlane(v, vRowStride, vPixelStride, vOffset)};
+  auto histogram = YuvSampler::makeHistogram(
+      frame, bt709 ? YuvSampler::Matrix::BT709 : YuvSampler::Matrix::BT601,
+      fullRange, static_cast<int>(std::clamp(quality, 1.0, 10.0)),
+      ignoreWhite);
+  return quantizeHistogram(histogram, colorCount);
+}
+
+std::shared_ptr<PaletteCache>
+margelo::nitro::nitropalette::NitroPalette::getCache() {
+  std::lock_guard<std::mutex> lock(cacheMutex_);
+  return cache_;
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::quantizeToStrings(
+    const std::vector<uint8_t>& pixels, double colorCount, double quality,
+    bool ignoreWhite, const CancellationToken* token) {
+  if (pixels.size() < 4 || pixels.size() % 4 != 0) {
+    return {};
+  }
+
+  colorCount = std::clamp(colorCount, 1.0, 20.0);
+  quality = std::clamp(quality, 1.0, 10.0);
+
+  auto colorMap = MMCQ::quantize(pixels, static_cast<int>(colorCount),
+                                 static_cast<int>(quality), ignoreWhite, token);
+  if (!colorMap) {
+    return {};
+  }
+
+  return makeColorStrings(colorMap->makePalette(),
+                          static_cast<int>(colorCount));
+}
+
+std::shared_ptr<margelo::nitro::ArrayBuffer>
+margelo::nitro::nitropalette::NitroPalette::makeArrayBuffer(
+    const std::vector<uint8_t>& bytes) {
+  auto buffer = ArrayBuffer::allocate(bytes.size());
+  std::copy(bytes.begin(), bytes.end(), buffer->data());
+  return buffer;
+}
+
+std::vector<std::string>
+margelo::nitro::nitropalette::NitroPalette::quantizeHistogram(
+    const MMCQ::Histogram& histogram, double colorCount) {
+  int maxColors = static_cast<int>(std::clamp(colorCount, 1.0, 20.0));
+  auto colorMap = MMCQ::quantize(histogram, maxColors);
+  if (!colorMap) {
+    return {};
+  }
+  return makeColorStrings(colorMap->makePalette(), maxColors);
+}
+
+YuvSampler::Plane margelo::nitro::nitropalette::NitroPalette::makePlane(
+    const std::shared_ptr<ArrayBuffer>& buffer, double rowStride,
+    double pixelStride, double offset) {
+  constexpr double maxStride = std::numeric_limits<int>::max();
+  if (!buffer || !(offset >= 0) || offset >= buffer->size() ||
+      !(rowStride >= 0 && rowStride <= maxStride) ||
+      !(pixelStride >= 0 && pixelStride <= maxStride)) {
+    throw std::runtime_error("Invalid YUV frame");
+  }
+  auto start = static_cast<size_t>(offset);
+  return {reinterpret_cast<uint8_t*>(buffer->data()) + start,
+          buffer->size() - start, static_cast<int>(rowStride),
+          static_cast<int>(pixelStride)};
+}
+
+std::vector<std::vector<uint8_t>>
+margelo::nitro::nitropalette::NitroPalette::copyImages(
+    const std::vector<std::shared_ptr<ArrayBuffer>>& sources) {
+  std::vector<std::vector<uint8_t>> images;
+  images.reserve(sources.size());
+  for (const auto& source : sources) {
+    std::vector<uint8_t> pixels;
+    if (source) {
+      auto data = reinterpret_cast<uint8_t*>(source->data());
+      pixels.assign(data, data + source->size());
+    }
+    images.push_back(std::move(pixels));
+  }
+  return images;
+}
+
+margelo::nitro::nitropalette::NitroPalette::MemoryReservation::
+    MemoryReservation(std::shared_ptr<std::atomic<size_t>> inFlightBytes,
+                      size_t bytes)
+    : inFlightBytes_(std::move(inFlightBytes)), bytes_(bytes) {
+  inFlightBytes_->fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void margelo::nitro::nitropalette::NitroPalette::MemoryReservation::release() {
+  size_t bytes = bytes_.exchange(0, std::memory_order_relaxed);
+  inFlightBytes_->fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+std::shared_ptr<margelo::nitro::nitropalette::NitroPalette::MemoryReservation>
+margelo::nitro::nitropalette::NitroPalette::reserveMemory(size_t bytes) {
+  return std::make_shared<MemoryReservation>(inFlightBytes_, bytes);
+}
+
+std::shared_ptr<margelo::nitro::nitropalette::NitroPalette::MemoryReservation>
+margelo::nitro::nitropalette::NitroPalette::reserveMemory(
+    const std::vector<std::vector<uint8_t>>& images) {
+  size_t bytes = 0;
+  for (const auto& image : images) {
+    bytes += image.size();
+  }
+  return reserveMemory(bytes);
+}
@@ -1,11 +1,26 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <NitroModules/ArrayBuffer.hpp>
 #include "HybridNitroPaletteSpec.hpp"
+#include "MMCQ.hpp"
+#include "PaletteCache.hpp"
+#include "PaletteIndex.hpp"
+#include "PaletteScheduler.hpp"
+#include "PaletteTracker.hpp"
+#include "YuvSampler.hpp"
 
 namespace margelo {
 namespace nitro {
 namespace nitropalette {
+// Reentrant: every method may be called concurrently from any JS runtime
+// (the main runtime, worklet runtimes, frame processors) or native thread.
+// Per-call state lives on the stack or in the closures of async work;
+// the few members that persist between calls (frame tracker, palette index,
+// cache, request scheduler) are each guarded by their own lock.
 class NitroPalette : public HybridNitroPaletteSpec {
  public:
   NitroPalette() : HybridObject(TAG), HybridNitroPaletteSpec() {}
@@ -14,12 +29,206 @@ class NitroPalette : public HybridNitroPaletteSpec {
       const std::shared_ptr<ArrayBuffer>& source, double colorCount,
       double quality, bool ignoreWhite) override;
 
+  std::vector<std::string> trackFrame(
+      const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+      bool ignoreWhite) override;
+
+  void resetFrameTracking() override;
+
+  std::shared_ptr<Promise<BudgetedPalette>> extractColorsWithBudget(
+      const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+      bool ignoreWhite, double budgetMs,
+      const std::function<void(const std::vector<std::string>&)>&
+          onEarlyResult) override;
+
+  std::shared_ptr<Promise<std::vector<std::string>>> extractColorsFromEncoded(
+      const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+      double quality, bool ignoreWhite, double maxDimension) override;
+
+  std::shared_ptr<Promise<std::vector<std::string>>> extractColorsFromFile(
+      const std::string& path, double colorCount, double quality,
+      bool ignoreWhite, double maxDimension) override;
+
+  // Unique across every runtime sharing this object, unlike ids counted in
+  // each runtime's JS.
+  double createRequestId() override;
+
+  // Throws when a request with requestId is still queued or running.
+  std::shared_ptr<Promise<std::vector<std::string>>> extractColorsAsync(
+      const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+      double quality, bool ignoreWhite, double requestId,
+      double priority) override;
+
+  void cancelExtraction(double requestId) override;
+
+  void setExtractionPriority(double requestId, double priority) override;
+
+  std::vector<std::vector<std::string>> extractRegionColors(
+      const std::shared_ptr<ArrayBuffer>& source, double width, double height,
+      double columns, double rows, double edgeFraction, double colorCount,
+      double quality, bool ignoreWhite) override;
+
+  std::shared_ptr<Promise<void>> indexPalettes(
+      const std::vector<std::string>& ids,
+      const std::vector<std::shared_ptr<ArrayBuffer>>& sources, double quality,
+      bool ignoreWhite) override;
+
+  std::vector<std::string> findSimilarPalettes(
+      const std::vector<double>& colors, double count) override;
+
+  std::shared_ptr<ArrayBuffer> serializePaletteIndex() override;
+
+  void loadPaletteIndex(const std::shared_ptr<ArrayBuffer>& data) override;
+
+  void clearPaletteIndex() override;
+
+  void configureCache(const std::string& directory) override;
+
+  std::vector<std::string> getCachedColors(const std::string& key,
+                                           double colorCount, double quality,
+                                           bool ignoreWhite) override;
+
+  // Reads the planes in place; nothing is copied or converted to RGBA. Each
+  // plane maps onto a YuvSampler::Plane, so planar and semi-planar frames
+  // are passed as they come from the camera. The offsets let U and V share
+  // one interleaved buffer.
+  std::vector<std::string> extractColorsFromYuv(
+      const std::shared_ptr<ArrayBuffer>& y,
+      const std::shared_ptr<ArrayBuffer>& u,
+      const std::shared_ptr<ArrayBuffer>& v, double width, double height,
+      double yRowStride, double yPixelStride, double uRowStride,
+      double uPixelStride, double uOffset, double vRowStride,
+      double vPixelStride, double vOffset, bool bt709, bool fullRange,
+      double colorCount, double quality, bool ignoreWhite) override;
+
+  std::vector<std::string> extractColorsCached(
+      const std::string& key, const std::shared_ptr<ArrayBuffer>& source,
+      double colorCount, double quality, bool ignoreWhite) override;
+
+  std::vector<std::string> ditherToPalette(
+      const std::shared_ptr<ArrayBuffer>& source, double width, double height,
+      double colorCount, double quality, bool ignoreWhite,
+      const std::shared_ptr<ArrayBuffer>& output) override;
+
+  std::shared_ptr<ArrayBuffer> makeHistogram(
+      const std::shared_ptr<ArrayBuffer>& source, double quality,
+      bool ignoreWhite) override;
+
+  std::vector<std::string> extractColorsFromHistograms(
+      const std::vector<std::shared_ptr<ArrayBuffer>>& histograms,
+      const std::vector<double>& weights, double colorCount) override;
+
+  std::shared_ptr<Promise<std::vector<std::string>>> extractCollectionColors(
+      const std::vector<std::shared_ptr<ArrayBuffer>>& sources,
+      const std::vector<double>& weights, double colorCount, double quality,
+      bool ignoreWhite) override;
+
+  std::vector<Swatch> extractSwatches(
+      const std::shared_ptr<ArrayBuffer>& source, double quality,
+      bool ignoreWhite) override;
+
+  std::vector<std::string> extractColorsRefined(
+      const std::shared_ptr<ArrayBuffer>& source, double colorCount,
+      double quality, bool ignoreWhite) override;
+
+  std::shared_ptr<ArrayBuffer> makePaletteTree(
+      const std::shared_ptr<ArrayBuffer>& source, double maxColors,
+      double quality, bool ignoreWhite) override;
+
+  std::vector<std::string> extractColorsFromPaletteTree(
+      const std::shared_ptr<ArrayBuffer>& tree, double colorCount) override;
+
+  ImageAnalysis analyzeImage(const std::shared_ptr<ArrayBuffer>& source,
+                             double width, double height, double outputs,
+                             double colorCount, double quality,
+                             bool ignoreWhite) override;
+
+  // Counts the pixel copies of every call still in flight, so concurrent
+  // calls are all accounted for.
   size_t getExternalMemorySize() noexcept override {
-    return sizeof(NitroPalette) + currentImageSize_;
+    return sizeof(NitroPalette) +
+           inFlightBytes_->load(std::memory_order_relaxed);
   }
 
  private:
-  size_t currentImageSize_ = 0;
+  static std::vector<std::string> quantizeToStrings(
+      const std::vector<uint8_t>& pixels, double colorCount, double quality,
+      bool ignoreWhite, const CancellationToken* token = nullptr);
+
+  static std::vector<std::string> makeColorStrings(
+      const std::vector<MMCQ::Color>& palette);
+
+  // The first maxColors colors only: MMCQ's second pass can leave more boxes
+  // than were asked for.
+  static std::vector<std::string> makeColorStrings(
+      const std::vector<MMCQ::Color>& palette, int maxColors);
+
+  static std::shared_ptr<ArrayBuffer> makeArrayBuffer(
+      const std::vector<uint8_t>& bytes);
+
+  static std::vector<std::string> quantizeHistogram(
+      const MMCQ::Histogram& histogram, double colorCount);
+
+  // Throws std::runtime_error when the buffer is missing or offset lies
+  // outside it; the strides are checked against the frame by YuvSampler.
+  static YuvSampler::Plane makePlane(const std::shared_ptr<ArrayBuffer>& buffer,
+                                     double rowStride, double pixelStride,
+                                     double offset);
+
+  static std::vector<std::vector<uint8_t>> copyImages(
+      const std::vector<std::shared_ptr<ArrayBuffer>>& sources);
+
+  // Bytes counted as in flight until release() is called or the last copy
+  // of the handle goes away. Async work releases it before settling its
+  // promise, so the count has dropped by the time the caller sees the result.
+  class MemoryReservation {
+   public:
+    MemoryReservation(std::shared_ptr<std::atomic<size_t>> inFlightBytes,
+                      size_t bytes);
+    ~MemoryReservation() { release(); }
+
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    void release();
+
+   private:
+    std::shared_ptr<std::atomic<size_t>> inFlightBytes_;
+    std::atomic<size_t> bytes_;
+  };
+
+  // Releases a reservation when the scope exits, by return or by throw.
+  struct ReleaseOnExit {
+    std::shared_ptr<MemoryReservation> memory;
+    ~ReleaseOnExit() { memory->release(); }
+  };
+
+  std::shared_ptr<MemoryReservation> reserveMemory(size_t bytes);
+  std::shared_ptr<MemoryReservation> reserveMemory(
+      const std::vector<std::vector<uint8_t>>& images);
+
+  // Shared with async work, which may finish after this object.
+  std::shared_ptr<std::atomic<size_t>> inFlightBytes_ =
+      std::make_shared<std::atomic<size_t>>(0);
+
+  std::mutex trackerMutex_;
+  std::unique_ptr<PaletteTracker> tracker_;
+
+  // Shared with indexing promises, which may finish after this object.
+  std::shared_ptr<PaletteIndex> paletteIndex_ =
+      std::make_shared<PaletteIndex>();
+
+  std::shared_ptr<PaletteCache> getCache();
+
+  // Unset until configureCache is called.
+  std::mutex cacheMutex_;
+  std::shared_ptr<PaletteCache> cache_;
+
+  std::atomic<uint64_t> nextRequestId_{1};
+
+  // Declared last so queued requests are settled before the members
+  // above go away.
+  PaletteScheduler scheduler_{2};
 };
 
 }  // namespace nitropalette
@@ -0,0 +1,379 @@
+#include "PaletteCache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Holds an exclusive flock for its lifetime. Waiting is retried when a
+// signal interrupts it; on any other failure writes go ahead under the
+// mutex alone, as they would on a file system without locks.
+class FileLock {
+ public:
+  explicit FileLock(int file) : fd(file) {
+    while (fd >= 0 && flock(fd, LOCK_EX) != 0 && errno == EINTR) {
+    }
+  }
+  ~FileLock() {
+    if (fd >= 0) {
+      flock(fd, LOCK_UN);
+    }
+  }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+ private:
+  int fd;
+};
+
+// Counts a lookup for as long as it may read a mapping.
+class ReadScope {
+ public:
+  explicit ReadScope(std::atomic<int>& readers) : readers(readers) {
+    readers.fetch_add(1);
+  }
+  ~ReadScope() { readers.fetch_sub(1); }
+
+  ReadScope(const ReadScope&) = delete;
+  ReadScope& operator=(const ReadScope&) = delete;
+
+ private:
+  std::atomic<int>& readers;
+};
+
+}  // namespace
+
+PaletteCache::Mapping::~Mapping() {
+  if (address != nullptr) {
+    munmap(address, size);
+  }
+}
+
+PaletteCache::PaletteCache(const std::string& directory)
+    : path(directory + "/nitro-palette.cache") {
+  lockFile = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                  0644);
+  FileLock lock(lockFile);
+  auto mapping = openMapping(path);
+  if (!mapping) {
+    // Created aside and renamed, since another cache may still have a file
+    // of an older version mapped.
+    std::string temporaryPath = path + ".tmp";
+    mapping = makeMapping(temporaryPath, INITIAL_CAPACITY);
+    if (mapping &&
+        std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+      unlink(temporaryPath.c_str());
+      mapping = nullptr;
+    }
+  }
+  if (!mapping) {
+    if (lockFile >= 0) {
+      close(lockFile);
+    }
+    throw std::runtime_error("Failed to open palette cache");
+  }
+  install(std::move(mapping));
+}
+
+PaletteCache::~PaletteCache() {
+  if (lockFile >= 0) {
+    close(lockFile);
+  }
+}
+
+uint64_t PaletteCache::makeContentHash(const uint8_t* data, size_t size) {
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x100000001B3ULL;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ data[i]) * 0x100000001B3ULL;
+  }
+  return mix(hash);
+}
+
+uint64_t PaletteCache::makeKey(uint64_t contentHash, int maxColors,
+                               int quality, bool ignoreWhite) {
+  uint64_t parameters = static_cast<uint64_t>(maxColors) |
+                        static_cast<uint64_t>(quality) << 8 |
+                        static_cast<uint64_t>(ignoreWhite) << 16;
+  uint64_t key = mix(contentHash ^ mix(parameters + 1));
+  return key != 0 ? key : 1;
+}
+
+bool PaletteCache::find(uint64_t key,
+                        std::vector<MMCQ::Color>& palette) const {
+  ReadScope scope(readers);
+  const Mapping* mapping = current.load();
+  if (mapping->header->replaced.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    remapIfReplaced();
+    mapping = current.load();
+  }
+  uint32_t mask = mapping->capacity - 1;
+  Entry entry;
+  for (uint32_t probe = 0; probe < mapping->capacity; probe++) {
+    if (!readEntry(mapping->records[(key + probe) & mask], entry) ||
+        entry.key == 0) {
+      return false;
+    }
+    if (entry.key == key) {
+      palette.clear();
+      for (int i = 0; i < entry.colorCount; i++) {
+        palette.emplace_back(entry.colors[i * 3], entry.colors[i * 3 + 1],
+                             entry.colors[i * 3 + 2]);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void PaletteCache::store(uint64_t key,
+                         const std::vector<MMCQ::Color>& palette) {
+  if (key == 0 || palette.empty() || palette.size() > MAX_COLORS) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(writeMutex);
+  FileLock fileLock(lockFile);
+  remapIfReplaced();
+  reclaim();
+  Mapping* mapping = current.load(std::memory_order_relaxed);
+  Record* slot = findSlot(*mapping, key);
+  bool added = slot->entry.key != key;
+  if (added && (mapping->header->count + 1) * 4 > mapping->capacity * 3) {
+    if (!rehash()) {
+      return;
+    }
+    mapping = current.load(std::memory_order_relaxed);
+    slot = findSlot(*mapping, key);
+    added = slot->entry.key != key;
+  }
+
+  Entry entry{};
+  entry.key = key;
+  entry.stamp = mapping->header->stamp++;
+  entry.colorCount = static_cast<uint8_t>(palette.size());
+  for (size_t i = 0; i < palette.size(); i++) {
+    entry.colors[i * 3] = palette[i].r;
+    entry.colors[i * 3 + 1] = palette[i].g;
+    entry.colors[i * 3 + 2] = palette[i].b;
+  }
+  writeEntry(*slot, entry);
+  if (added) {
+    mapping->header->count++;
+  }
+}
+
+size_t PaletteCache::size() const {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  return current.load(std::memory_order_relaxed)->header->count;
+}
+
+std::unique_ptr<PaletteCache::Mapping> PaletteCache::makeMapping(
+    const std::string& path, uint32_t capacity) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  auto mapping = std::make_unique<Mapping>();
+  mapping->size = sizeof(Header) + sizeof(Record) * capacity;
+  // The file is truncated first, so every record starts out zeroed: empty,
+  // with an even sequence number.
+  struct stat status;
+  if (ftruncate(fd, static_cast<off_t>(mapping->size)) != 0 ||
+      fstat(fd, &status) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  void* address = mmap(nullptr, mapping->size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+
+  mapping->address = address;
+  mapping->header = static_cast<Header*>(address);
+  mapping->records = reinterpret_cast<Record*>(mapping->header + 1);
+  mapping->capacity = capacity;
+  mapping->device = status.st_dev;
+  mapping->inode = status.st_ino;
+  Header& header = *mapping->header;
+  header.magic = MAGIC;
+  header.formatVersion = FORMAT_VERSION;
+  header.algorithmVersion = ALGORITHM_VERSION;
+  header.recordSize = sizeof(Record);
+  header.capacity = capacity;
+  return mapping;
+}
+
+std::unique_ptr<PaletteCache::Mapping> PaletteCache::openMapping(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(Header)) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(status.st_size);
+  void* address =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto mapping = std::make_unique<Mapping>();
+  mapping->address = address;
+  mapping->size = size;
+  mapping->header = static_cast<Header*>(address);
+  mapping->records = reinterpret_cast<Record*>(mapping->header + 1);
+  mapping->capacity = mapping->header->capacity;
+  mapping->device = status.st_dev;
+  mapping->inode = status.st_ino;
+
+  const Header& header = *mapping->header;
+  uint32_t capacity = header.capacity;
+  if (header.magic != MAGIC || header.formatVersion != FORMAT_VERSION ||
+      header.algorithmVersion != ALGORITHM_VERSION ||
+      header.recordSize != sizeof(Record) || capacity == 0 ||
+      capacity > MAX_CAPACITY || (capacity & (capacity - 1)) != 0 ||
+      size != sizeof(Header) + sizeof(Record) * capacity) {
+    return nullptr;
+  }
+  return mapping;
+}
+
+bool PaletteCache::readEntry(const Record& record, Entry& entry) {
+  for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+    uint32_t before = record.sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    std::memcpy(&entry, &record.entry, sizeof(Entry));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (record.sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PaletteCache::writeEntry(Record& record, const Entry& entry) {
+  // A record can already be odd when an earlier process died mid-write;
+  // readers skip it until it is written again.
+  uint32_t sequence = record.sequence.load(std::memory_order_relaxed) | 1;
+  record.sequence.store(sequence, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&record.entry, &entry, sizeof(Entry));
+  record.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+PaletteCache::Record* PaletteCache::findSlot(const Mapping& mapping,
+                                             uint64_t key) {
+  // The load factor stays below 3/4, so an empty slot is always reached.
+  uint32_t mask = mapping.capacity - 1;
+  for (uint32_t probe = 0;; probe++) {
+    Record& record = mapping.records[(key + probe) & mask];
+    if (record.entry.key == key || record.entry.key == 0) {
+      return &record;
+    }
+  }
+}
+
+void PaletteCache::remapIfReplaced() const {
+  const Mapping* mapping = current.load(std::memory_order_relaxed);
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0 ||
+      (status.st_dev == mapping->device && status.st_ino == mapping->inode)) {
+    return;
+  }
+  if (auto replacement = openMapping(path)) {
+    install(std::move(replacement));
+  }
+}
+
+void PaletteCache::install(std::unique_ptr<Mapping> mapping) const {
+  current.store(mapping.get());
+  mappings.push_back(std::move(mapping));
+  reclaim();
+}
+
+void PaletteCache::reclaim() const {
+  // Both this load and the store of current are sequentially consistent, so
+  // a lookup that has not counted itself yet will load the current mapping.
+  if (mappings.size() > 1 && readers.load() == 0) {
+    mappings.erase(mappings.begin(), mappings.end() - 1);
+  }
+}
+
+bool PaletteCache::rehash() {
+  const Mapping& previous = *current.load(std::memory_order_relaxed);
+  std::vector<const Entry*> kept;
+  kept.reserve(previous.header->count);
+  for (uint32_t i = 0; i < previous.capacity; i++) {
+    if (previous.records[i].entry.key != 0) {
+      kept.push_back(&previous.records[i].entry);
+    }
+  }
+
+  uint32_t capacity = previous.capacity;
+  if (capacity < MAX_CAPACITY) {
+    capacity *= 2;
+  } else {
+    auto newest = kept.begin() + kept.size() / 2;
+    std::nth_element(kept.begin(), newest, kept.end(),
+                     [](const Entry* a, const Entry* b) {
+                       return a->stamp > b->stamp;
+                     });
+    kept.erase(newest, kept.end());
+  }
+
+  std::string temporaryPath = path + ".tmp";
+  auto mapping = makeMapping(temporaryPath, capacity);
+  if (!mapping) {
+    return false;
+  }
+  for (const Entry* entry : kept) {
+    writeEntry(*findSlot(*mapping, entry->key), *entry);
+  }
+  mapping->header->count = static_cast<uint32_t>(kept.size());
+  mapping->header->stamp = previous.header->stamp;
+
+  if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+    unlink(temporaryPath.c_str());
+    return false;
+  }
+  previous.header->replaced.store(1, std::memory_order_release);
+  install(std::move(mapping));
+  return true;
+}
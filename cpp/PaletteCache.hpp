@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "MMCQ.hpp"
+
+// Palettes kept across launches in a memory-mapped file of fixed-size
+// records, laid out as an open-addressing table keyed by a hash of the image
+// content (or a caller id) and the extraction parameters. Lookups read the
+// mapping in place, so a cached palette costs no parsing and no pixels.
+//
+// Readers take no lock: every record carries a sequence number that writers
+// make odd while they change it, and readers retry until they copy a record
+// between two equal, even sequence numbers. Writers are serialized by a
+// mutex within one cache and by an flock on a lock file next to the cache
+// file across caches, so several caches on the same directory, in one
+// process or several, can write safely. When the table fills up it is
+// rehashed into a larger file, or, at the size limit, compacted to its most
+// recently written half, and the new file is renamed over the old one and
+// the old one is flagged as replaced. Other caches map the new file on
+// their next lookup or write. Replaced mappings are unmapped by the first
+// write that finds no lookup in progress, so memory does not grow with
+// every rehash.
+class PaletteCache {
+ public:
+  static constexpr int MAX_COLORS = 40;
+
+  // Opens or creates the cache file in directory. Only the header is checked
+  // on open; a file written by another format or algorithm version is
+  // discarded. Throws std::runtime_error when
+  // the file cannot be created or mapped.
+  explicit PaletteCache(const std::string& directory);
+  ~PaletteCache();
+
+  PaletteCache(const PaletteCache&) = delete;
+  PaletteCache& operator=(const PaletteCache&) = delete;
+
+  static uint64_t makeContentHash(const uint8_t* data, size_t size);
+  static uint64_t makeKey(uint64_t contentHash, int maxColors, int quality,
+                          bool ignoreWhite);
+
+  bool find(uint64_t key, std::vector<MMCQ::Color>& palette) const;
+  // Palettes that are empty or longer than MAX_COLORS are not stored, and
+  // neither is anything once the file can no longer grow on disk.
+  void store(uint64_t key, const std::vector<MMCQ::Color>& palette);
+  size_t size() const;
+
+ private:
+  static constexpr uint32_t MAGIC = 0x43504E50;  // "PNPC"
+  static constexpr uint32_t FORMAT_VERSION = 1;
+  // Bump whenever quantization output changes, so palettes cut by an older
+  // algorithm are dropped instead of served.
+  static constexpr uint32_t ALGORITHM_VERSION = 2;
+  static constexpr uint32_t INITIAL_CAPACITY = 1024;
+  static constexpr uint32_t MAX_CAPACITY = 1 << 16;
+  // Attempts at copying a record before a reader treats it as a miss.
+  static constexpr int READ_ATTEMPTS = 64;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint32_t algorithmVersion;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t stamp;
+    // Set once another file has been renamed over this one.
+    std::atomic<uint32_t> replaced;
+  };
+
+  struct Entry {
+    // 0 marks an empty slot.
+    uint64_t key;
+    // Write order, used to keep the newest entries when compacting.
+    uint32_t stamp;
+    uint8_t colorCount;
+    uint8_t colors[MAX_COLORS * 3];
+  };
+
+  struct Record {
+    std::atomic<uint32_t> sequence;
+    uint32_t reserved;
+    Entry entry;
+  };
+
+  static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                "Records are shared through a file mapping");
+
+  struct Mapping {
+    ~Mapping();
+
+    void* address = nullptr;
+    size_t size = 0;
+    Header* header = nullptr;
+    Record* records = nullptr;
+    uint32_t capacity = 0;
+    // Identity of the mapped file, to notice when it was replaced.
+    dev_t device = 0;
+    ino_t inode = 0;
+  };
+
+  static std::unique_ptr<Mapping> makeMapping(const std::string& path,
+                                              uint32_t capacity);
+  static std::unique_ptr<Mapping> openMapping(const std::string& path);
+  static bool readEntry(const Record& record, Entry& entry);
+  static void writeEntry(Record& record, const Entry& entry);
+  static Record* findSlot(const Mapping& mapping, uint64_t key);
+
+  // Called with writeMutex held. Maps the cache file again when another
+  // cache has renamed a new one over it.
+  void remapIfReplaced() const;
+  // Called with writeMutex held. Makes mapping current.
+  void install(std::unique_ptr<Mapping> mapping) const;
+  // Called with writeMutex held. Unmaps the replaced mappings if no lookup
+  // can still be reading them.
+  void reclaim() const;
+  // Called with writeMutex and the file lock held. Returns false, keeping
+  // the current file, when the new one cannot be written.
+  bool rehash();
+
+  std::string path;
+  mutable std::mutex writeMutex;
+  int lockFile = -1;
+  // Lookups in progress. A lookup counts itself before loading current, so
+  // once a new mapping is current and the count is seen at zero, no lookup
+  // can still reach the replaced ones.
+  mutable std::atomic<int> readers{0};
+  mutable std::atomic<Mapping*> current{nullptr};
+  // The current mapping last, after any replaced ones still to be unmapped.
+  mutable std::vector<std::unique_ptr<Mapping>> mappings;
+};
@@ -0,0 +1,350 @@
+#include "PaletteIndex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+float makeLinear(uint8_t channel) {
+  float value = channel / 255.0f;
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float makeLabComponent(float t) {
+  constexpr float epsilon = 216.0f / 24389.0f;
+  constexpr float kappa = 24389.0f / 27.0f;
+  return t > epsilon ? std::cbrt(t) : (kappa * t + 16.0f) / 116.0f;
+}
+
+template <typename T>
+void write(std::vector<uint8_t>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T read(const uint8_t* data, size_t size, size_t& offset) {
+  if (size - offset < sizeof(T)) {
+    throw std::runtime_error("Invalid palette index data");
+  }
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  offset += sizeof(T);
+  return value;
+}
+
+}  // namespace
+
+PaletteIndex::Signature PaletteIndex::makeSignature(
+    const MMCQ::ColorMap& colorMap) {
+  std::vector<MMCQ::VBox> vboxes = colorMap.getVBoxes();
+  std::sort(vboxes.begin(), vboxes.end(),
+            [](const MMCQ::VBox& a, const MMCQ::VBox& b) {
+              return a.count > b.count;
+            });
+  if (vboxes.size() > SIGNATURE_SIZE) {
+    vboxes.resize(SIGNATURE_SIZE);
+  }
+
+  double total = 0;
+  for (const auto& vbox : vboxes) {
+    total += vbox.count;
+  }
+
+  Signature signature{};
+  for (size_t i = 0; i < vboxes.size() && total > 0; i++) {
+    signature.colors[i] = makeLab(vboxes[i].average);
+    signature.weights[i] = static_cast<float>(vboxes[i].count / total);
+  }
+  return signature;
+}
+
+PaletteIndex::Signature PaletteIndex::makeSignature(
+    const std::vector<MMCQ::Color>& colors) {
+  size_t size = std::min<size_t>(colors.size(), SIGNATURE_SIZE);
+  Signature signature{};
+  for (size_t i = 0; i < size; i++) {
+    signature.colors[i] = makeLab(colors[i]);
+    signature.weights[i] = 1.0f / size;
+  }
+  return signature;
+}
+
+PaletteIndex::LabColor PaletteIndex::makeLab(const MMCQ::Color& color) {
+  float r = makeLinear(color.r);
+  float g = makeLinear(color.g);
+  float b = makeLinear(color.b);
+
+  // sRGB to XYZ, relative to the D65 white point.
+  float x = (0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / 0.95047f;
+  float y = 0.2126729f * r + 0.7151522f * g + 0.0721750f * b;
+  float z = (0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / 1.08883f;
+
+  float fx = makeLabComponent(x);
+  float fy = makeLabComponent(y);
+  float fz = makeLabComponent(z);
+  return {116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz)};
+}
+
+void PaletteIndex::insert(const std::vector<std::string>& newIds,
+                          const std::vector<Signature>& newSignatures) {
+  if (newIds.size() != newSignatures.size()) {
+    throw std::runtime_error("Every palette needs an id");
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  for (size_t i = 0; i < newIds.size(); i++) {
+    add(newIds[i], newSignatures[i]);
+  }
+  rebuild();
+}
+
+std::vector<PaletteIndex::Match> PaletteIndex::findNearest(
+    const Signature& query, size_t count) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (count == 0 || points.empty()) {
+    return {};
+  }
+
+  int queryColors = 0;
+  for (float weight : query.weights) {
+    queryColors += weight > 0 ? 1 : 0;
+  }
+  if (queryColors == 0) {
+    return {};
+  }
+
+  std::vector<std::pair<float, uint32_t>> ranked;
+  if (queryColors == 1) {
+    // The distance to a single color is exactly what the tree searches by.
+    Nearest nearest(count);
+    search(query.colors[0], 0, points.size(), 0, nearest);
+    for (const auto& [distance, entry] : nearest.getEntries()) {
+      ranked.emplace_back(std::sqrt(distance), entry);
+    }
+  } else {
+    std::vector<uint32_t> candidates;
+    for (int i = 0; i < SIGNATURE_SIZE; i++) {
+      if (query.weights[i] <= 0) {
+        continue;
+      }
+      Nearest nearest(count * CANDIDATE_FACTOR);
+      search(query.colors[i], 0, points.size(), 0, nearest);
+      for (const auto& entry : nearest.getEntries()) {
+        candidates.push_back(entry.second);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    for (uint32_t entry : candidates) {
+      ranked.emplace_back(makeDistance(query, signatures[entry]), entry);
+    }
+  }
+
+  size_t size = std::min(count, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + size, ranked.end());
+
+  std::vector<Match> matches;
+  matches.reserve(size);
+  for (size_t i = 0; i < size; i++) {
+    matches.push_back({ids[ranked[i].second], ranked[i].first});
+  }
+  return matches;
+}
+
+void PaletteIndex::clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  ids.clear();
+  signatures.clear();
+  entryOf.clear();
+  points.clear();
+}
+
+size_t PaletteIndex::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return ids.size();
+}
+
+std::vector<uint8_t> PaletteIndex::serialize() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  std::vector<uint8_t> out;
+  write(out, MAGIC);
+  write(out, VERSION);
+  write(out, static_cast<uint32_t>(ids.size()));
+  for (size_t i = 0; i < ids.size(); i++) {
+    write(out, static_cast<uint32_t>(ids[i].size()));
+    out.insert(out.end(), ids[i].begin(), ids[i].end());
+    write(out, signatures[i]);
+  }
+  return out;
+}
+
+void PaletteIndex::deserialize(const uint8_t* data, size_t size) {
+  if (data == nullptr) {
+    throw std::runtime_error("Invalid palette index data");
+  }
+
+  size_t offset = 0;
+  if (read<uint32_t>(data, size, offset) != MAGIC ||
+      read<uint32_t>(data, size, offset) != VERSION) {
+    throw std::runtime_error("Invalid palette index data");
+  }
+  uint32_t count = read<uint32_t>(data, size, offset);
+
+  std::vector<std::string> newIds;
+  std::vector<Signature> newSignatures;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t length = read<uint32_t>(data, size, offset);
+    if (size - offset < length) {
+      throw std::runtime_error("Invalid palette index data");
+    }
+    newIds.emplace_back(reinterpret_cast<const char*>(data + offset), length);
+    offset += length;
+    newSignatures.push_back(read<Signature>(data, size, offset));
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  ids.clear();
+  signatures.clear();
+  entryOf.clear();
+  for (size_t i = 0; i < newIds.size(); i++) {
+    add(newIds[i], newSignatures[i]);
+  }
+  rebuild();
+}
+
+void PaletteIndex::Nearest::offer(uint32_t entry, float distance) {
+  for (auto& found : entries) {
+    if (found.second == entry) {
+      if (distance < found.first) {
+        found.first = distance;
+        worst = static_cast<size_t>(
+            std::max_element(entries.begin(), entries.end()) -
+            entries.begin());
+      }
+      return;
+    }
+  }
+
+  if (entries.size() < capacity) {
+    entries.emplace_back(distance, entry);
+  } else if (distance < entries[worst].first) {
+    entries[worst] = {distance, entry};
+  } else {
+    return;
+  }
+  worst = static_cast<size_t>(
+      std::max_element(entries.begin(), entries.end()) - entries.begin());
+}
+
+float PaletteIndex::Nearest::bound() const {
+  return entries.size() < capacity ? std::numeric_limits<float>::max()
+                                   : entries[worst].first;
+}
+
+float PaletteIndex::component(const LabColor& color, int axis) {
+  switch (axis) {
+    case 0:
+      return color.l;
+    case 1:
+      return color.a;
+    default:
+      return color.b;
+  }
+}
+
+float PaletteIndex::makeDistanceSquared(const LabColor& a, const LabColor& b) {
+  float dl = a.l - b.l;
+  float da = a.a - b.a;
+  float db = a.b - b.b;
+  return dl * dl + da * da + db * db;
+}
+
+float PaletteIndex::makeDistance(const Signature& query,
+                                 const Signature& other) {
+  // How well each query color is covered by the closest color of the other
+  // palette, weighted by the query.
+  float distance = 0;
+  for (int i = 0; i < SIGNATURE_SIZE; i++) {
+    if (query.weights[i] <= 0) {
+      continue;
+    }
+    float closest = std::numeric_limits<float>::max();
+    for (int j = 0; j < SIGNATURE_SIZE; j++) {
+      if (other.weights[j] > 0) {
+        closest = std::min(
+            closest, makeDistanceSquared(query.colors[i], other.colors[j]));
+      }
+    }
+    distance += query.weights[i] * std::sqrt(closest);
+  }
+  return distance;
+}
+
+void PaletteIndex::add(const std::string& id, const Signature& signature) {
+  auto [it, inserted] = entryOf.emplace(id, static_cast<uint32_t>(ids.size()));
+  if (inserted) {
+    ids.push_back(id);
+    signatures.push_back(signature);
+  } else {
+    signatures[it->second] = signature;
+  }
+}
+
+void PaletteIndex::rebuild() {
+  points.clear();
+  for (size_t entry = 0; entry < signatures.size(); entry++) {
+    for (int i = 0; i < SIGNATURE_SIZE; i++) {
+      if (signatures[entry].weights[i] > 0) {
+        points.push_back(
+            {signatures[entry].colors[i], static_cast<uint32_t>(entry)});
+      }
+    }
+  }
+  build(0, points.size(), 0);
+}
+
+void PaletteIndex::build(size_t begin, size_t end, int axis) {
+  if (end - begin <= 1) {
+    return;
+  }
+  size_t mid = begin + (end - begin) / 2;
+  std::nth_element(points.begin() + begin, points.begin() + mid,
+                   points.begin() + end,
+                   [axis](const Point& a, const Point& b) {
+                     return component(a.color, axis) <
+                            component(b.color, axis);
+                   });
+  int next = (axis + 1) % 3;
+  build(begin, mid, next);
+  build(mid + 1, end, next);
+}
+
+void PaletteIndex::search(const LabColor& target, size_t begin, size_t end,
+                          int axis, Nearest& nearest) const {
+  if (begin >= end) {
+    return;
+  }
+  size_t mid = begin + (end - begin) / 2;
+  const Point& point = points[mid];
+  nearest.offer(point.entry, makeDistanceSquared(point.color, target));
+
+  float delta = component(target, axis) - component(point.color, axis);
+  int next = (axis + 1) % 3;
+  if (delta < 0) {
+    search(target, begin, mid, next, nearest);
+    if (delta * delta < nearest.bound()) {
+      search(target, mid + 1, end, next, nearest);
+    }
+  } else {
+    search(target, mid + 1, end, next, nearest);
+    if (delta * delta < nearest.bound()) {
+      search(target, begin, mid, next, nearest);
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Searchable collection of palette signatures, keyed by caller-chosen ids
+// such as image URIs. Every signature color is a point of a k-d tree over
+// CIELAB, so finding the palettes closest to a color only visits the few
+// tree nodes around it. Safe to query and update from several threads.
+class PaletteIndex {
+ public:
+  static constexpr int SIGNATURE_SIZE = 8;
+
+  struct LabColor {
+    float l;
+    float a;
+    float b;
+  };
+
+  // Fixed-size summary of a palette: its most populous colors, heaviest
+  // first, with their share of the sampled pixels. Unused slots weigh 0.
+  struct Signature {
+    std::array<LabColor, SIGNATURE_SIZE> colors;
+    std::array<float, SIGNATURE_SIZE> weights;
+  };
+
+  struct Match {
+    std::string id;
+    // Weighted CIE76 distance from the query colors to the closest colors
+    // of the palette.
+    float distance;
+  };
+
+  static Signature makeSignature(const MMCQ::ColorMap& colorMap);
+  // Gives every color the same weight, for queries such as brand colors.
+  static Signature makeSignature(const std::vector<MMCQ::Color>& colors);
+  static LabColor makeLab(const MMCQ::Color& color);
+
+  // Adds a batch of signatures and rebuilds the tree once. An id that is
+  // already indexed gets the new signature.
+  void insert(const std::vector<std::string>& ids,
+              const std::vector<Signature>& signatures);
+  // The count palettes closest to the query, nearest first. Exact for a
+  // single query color; for several, candidates found around each query
+  // color are ranked by their full distance.
+  std::vector<Match> findNearest(const Signature& query, size_t count) const;
+  void clear();
+  size_t size() const;
+
+  std::vector<uint8_t> serialize() const;
+  // Replaces the contents with serialized data. Throws std::runtime_error
+  // when the data was not written by serialize.
+  void deserialize(const uint8_t* data, size_t size);
+
+ private:
+  struct Point {
+    LabColor color;
+    uint32_t entry;
+  };
+
+  // Distinct entries closest to a color found so far, up to a capacity.
+  class Nearest {
+   public:
+    explicit Nearest(size_t capacity) : capacity(capacity) {}
+    void offer(uint32_t entry, float distance);
+    float bound() const;
+    const std::vector<std::pair<float, uint32_t>>& getEntries() const {
+      return entries;
+    }
+
+   private:
+    size_t capacity;
+    size_t worst = 0;
+    std::vector<std::pair<float, uint32_t>> entries;
+  };
+
+  static constexpr uint32_t MAGIC = 0x5849504E;  // "NPIX"
+  static constexpr uint32_t VERSION = 1;
+  // Candidates gathered per query color before ranking a multi-color query.
+  static constexpr size_t CANDIDATE_FACTOR = 8;
+
+  static float component(const LabColor& color, int axis);
+  static float makeDistanceSquared(const LabColor& a, const LabColor& b);
+  static float makeDistance(const Signature& query, const Signature& other);
+
+  // Callers hold the lock exclusively.
+  void add(const std::string& id, const Signature& signature);
+  void rebuild();
+  void build(size_t begin, size_t end, int axis);
+  void search(const LabColor& target, size_t begin, size_t end, int axis,
+              Nearest& nearest) const;
+
+  mutable std::shared_mutex mutex;
+  std::vector<std::string> ids;
+  std::vector<Signature> signatures;
+  std::unordered_map<std::string, uint32_t> entryOf;
+  // Balanced k-d tree stored in place: the median of each range is its
+  // node, split on l, a and b in turn.
+  std::vector<Point> points;
+};
@@ -0,0 +1,106 @@
+#include "PaletteScheduler.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+PaletteScheduler::PaletteScheduler(size_t threadCount) {
+  threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    threads.emplace_back([this]() { run(); });
+  }
+}
+
+PaletteScheduler::~PaletteScheduler() {
+  std::vector<Request> abandoned;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    abandoned.swap(queue);
+    for (auto& entry : running) {
+      entry.second.cancel();
+    }
+  }
+  condition.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto& request : abandoned) {
+    request.onCancelled();
+  }
+}
+
+void PaletteScheduler::schedule(uint64_t id, int priority, Task task,
+                                std::function<void()> onCancelled) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running.count(id) > 0 ||
+        std::any_of(queue.begin(), queue.end(),
+                    [id](const Request& request) { return request.id == id; })) {
+      throw std::runtime_error("Request id is already in use");
+    }
+    if (!stopping) {
+      queue.push_back({id, priority, nextSequence++, CancellationToken(),
+                       std::move(task), std::move(onCancelled)});
+      condition.notify_one();
+      return;
+    }
+  }
+  onCancelled();
+}
+
+void PaletteScheduler::cancel(uint64_t id) {
+  std::vector<Request> cancelled;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = running.find(id);
+    if (it != running.end()) {
+      it->second.cancel();
+    }
+    auto end = std::stable_partition(
+        queue.begin(), queue.end(),
+        [id](const Request& request) { return request.id != id; });
+    std::move(end, queue.end(), std::back_inserter(cancelled));
+    queue.erase(end, queue.end());
+  }
+  for (auto& request : cancelled) {
+    request.onCancelled();
+  }
+}
+
+void PaletteScheduler::setPriority(uint64_t id, int priority) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& request : queue) {
+    if (request.id == id) {
+      request.priority = priority;
+    }
+  }
+}
+
+void PaletteScheduler::run() {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+      if (stopping) {
+        return;
+      }
+
+      auto next = std::min_element(
+          queue.begin(), queue.end(), [](const Request& a, const Request& b) {
+            if (a.priority != b.priority) {
+              return a.priority > b.priority;
+            }
+            return a.sequence < b.sequence;
+          });
+      request = std::move(*next);
+      queue.erase(next);
+      running.emplace(request.id, request.token);
+    }
+
+    request.task(request.token);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running.erase(request.id);
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CancellationToken.hpp"
+
+// Runs palette requests on a few background threads, highest priority
+// first and in submission order within a priority. Queued requests can be
+// reprioritized or cancelled; cancelling a running request trips the token
+// it was started with.
+class PaletteScheduler {
+ public:
+  using Task = std::function<void(const CancellationToken& token)>;
+
+  explicit PaletteScheduler(size_t threadCount);
+  ~PaletteScheduler();
+
+  PaletteScheduler(const PaletteScheduler&) = delete;
+  PaletteScheduler& operator=(const PaletteScheduler&) = delete;
+
+  // onCancelled runs instead of task when the request is cancelled, or the
+  // scheduler is destroyed, before it starts. Throws std::runtime_error when
+  // a request with the same id is still queued or running.
+  void schedule(uint64_t id, int priority, Task task,
+                std::function<void()> onCancelled);
+  void cancel(uint64_t id);
+  void setPriority(uint64_t id, int priority);
+
+ private:
+  struct Request {
+    uint64_t id;
+    int priority;
+    uint64_t sequence;
+    CancellationToken token;
+    Task task;
+    std::function<void()> onCancelled;
+  };
+
+  void run();
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<Request> queue;
+  std::unordered_map<uint64_t, CancellationToken> running;
+  std::vector<std::thread> threads;
+  uint64_t nextSequence = 0;
+  bool stopping = false;
+};
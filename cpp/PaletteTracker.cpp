@@ -0,0 +1,211 @@
+#include "PaletteTracker.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PaletteTracker::PaletteTracker(int maxColors, bool ignoreWhite)
+    : maxColors(maxColors), ignoreWhite(ignoreWhite) {
+  reset();
+}
+
+void PaletteTracker::reset() {
+  frameIndex = 0;
+  histogram.assign(MMCQ::HISTOGRAM_SIZE, 0.0f);
+  boxOfBin.assign(MMCQ::HISTOGRAM_SIZE, NO_BOX);
+  slots.clear();
+  cuts.clear();
+  referencePopulation.clear();
+  palette.clear();
+  unassigned = 0.0f;
+  total = 0.0f;
+}
+
+int PaletteTracker::getMaxColors() const { return maxColors; }
+
+bool PaletteTracker::getIgnoreWhite() const { return ignoreWhite; }
+
+std::vector<MMCQ::Color> PaletteTracker::track(const uint8_t* pixels,
+                                               size_t size) {
+  size_t pixelCount = size / 4;
+  if (pixelCount == 0) {
+    return palette;
+  }
+
+  for (auto& value : histogram) {
+    value *= DECAY;
+  }
+  for (auto& slot : slots) {
+    slot.count *= DECAY;
+    slot.rSum *= DECAY;
+    slot.gSum *= DECAY;
+    slot.bSum *= DECAY;
+  }
+  unassigned *= DECAY;
+  total *= DECAY;
+
+  // Walk a different phase of the sampling grid on every frame so a still
+  // scene is eventually covered pixel by pixel.
+  size_t stride = std::max<size_t>(1, pixelCount / SAMPLES_PER_FRAME);
+  size_t offset = frameIndex % stride;
+  frameIndex++;
+
+  for (size_t i = offset; i < pixelCount; i += stride) {
+    const uint8_t* pixel = &pixels[i * 4];
+    uint8_t r = pixel[0];
+    uint8_t g = pixel[1];
+    uint8_t b = pixel[2];
+    if (MMCQ::isIgnoredPixel(r, g, b, pixel[3], ignoreWhite)) {
+      continue;
+    }
+
+    int index = MMCQ::makeColorIndexOf(r >> MMCQ::RIGHT_SHIFT,
+                                       g >> MMCQ::RIGHT_SHIFT,
+                                       b >> MMCQ::RIGHT_SHIFT);
+    histogram[index] += 1.0f;
+    total += 1.0f;
+
+    uint8_t box = boxOfBin[index];
+    if (box == NO_BOX) {
+      unassigned += 1.0f;
+      continue;
+    }
+    Slot& slot = slots[box];
+    slot.count += 1.0f;
+    slot.rSum += r;
+    slot.gSum += g;
+    slot.bSum += b;
+  }
+
+  if (slots.empty() || makeDrift() > DRIFT_THRESHOLD) {
+    recut();
+  }
+
+  for (size_t i = 0; i < palette.size(); i++) {
+    palette[i] = makeSlotColor(slots[i], palette[i]);
+  }
+  return std::vector<MMCQ::Color>(
+      palette.begin(),
+      palette.begin() + std::min<size_t>(palette.size(), maxColors));
+}
+
+float PaletteTracker::makeDrift() const {
+  if (total <= 0.0f) {
+    return 0.0f;
+  }
+
+  float moved = 0.0f;
+  for (size_t i = 0; i < slots.size(); i++) {
+    moved += std::abs(slots[i].count / total - referencePopulation[i]);
+  }
+  return moved / 2 + unassigned / total;
+}
+
+MMCQ::Color PaletteTracker::makeSlotColor(const Slot& slot,
+                                          const MMCQ::Color& fallback) const {
+  if (slot.count <= 0.0f) {
+    return fallback;
+  }
+  return MMCQ::Color(
+      static_cast<uint8_t>(std::min(slot.rSum / slot.count, 255.0f)),
+      static_cast<uint8_t>(std::min(slot.gSum / slot.count, 255.0f)),
+      static_cast<uint8_t>(std::min(slot.bSum / slot.count, 255.0f)));
+}
+
+void PaletteTracker::recut() {
+  MMCQ::Histogram counts = MMCQ::makeEmptyHistogram();
+  bool occupied = false;
+  for (int index = 0; index < MMCQ::HISTOGRAM_SIZE; index++) {
+    int count = static_cast<int>(std::lround(histogram[index] * HISTOGRAM_SCALE));
+    counts.counts[index] = count;
+    occupied = occupied || count != 0;
+  }
+  if (!occupied) {
+    return;
+  }
+  MMCQ::fitBounds(counts);
+
+  // Start from the previous cuts; only the boxes whose split drifted are
+  // cut again.
+  std::vector<MMCQ::Cut> previous = std::move(cuts);
+  cuts.clear();
+  auto colorMap =
+      MMCQ::quantizeFromCuts(counts, maxColors, previous, CUT_TOLERANCE, cuts);
+  if (!colorMap) {
+    return;
+  }
+  const auto& vboxes = colorMap->getVBoxes();
+  size_t boxCount = std::min<size_t>(vboxes.size(), NO_BOX);
+
+  // Give each previous palette entry the closest new box so colors keep
+  // their position across cuts instead of reshuffling.
+  std::vector<size_t> order;
+  std::vector<bool> used(boxCount, false);
+  for (const auto& color : palette) {
+    int bestDistance = std::numeric_limits<int>::max();
+    size_t best = boxCount;
+    for (size_t i = 0; i < boxCount; i++) {
+      if (used[i]) {
+        continue;
+      }
+      int dr = static_cast<int>(color.r) - vboxes[i].average.r;
+      int dg = static_cast<int>(color.g) - vboxes[i].average.g;
+      int db = static_cast<int>(color.b) - vboxes[i].average.b;
+      int distance = dr * dr + dg * dg + db * db;
+      if (distance < bestDistance) {
+        bestDistance = distance;
+        best = i;
+      }
+    }
+    if (best == boxCount) {
+      break;
+    }
+    used[best] = true;
+    order.push_back(best);
+  }
+  for (size_t i = 0; i < boxCount; i++) {
+    if (!used[i]) {
+      order.push_back(i);
+    }
+  }
+
+  std::fill(boxOfBin.begin(), boxOfBin.end(), NO_BOX);
+  slots.assign(order.size(), Slot{0.0f, 0.0f, 0.0f, 0.0f});
+  palette.resize(order.size());
+  for (size_t slot = 0; slot < order.size(); slot++) {
+    const MMCQ::VBox& vbox = vboxes[order[slot]];
+    palette[slot] = vbox.average;
+    for (int r = vbox.rMin; r <= vbox.rMax; r++) {
+      for (int g = vbox.gMin; g <= vbox.gMax; g++) {
+        for (int b = vbox.bMin; b <= vbox.bMax; b++) {
+          boxOfBin[MMCQ::makeColorIndexOf(r, g, b)] =
+              static_cast<uint8_t>(slot);
+        }
+      }
+    }
+  }
+
+  // Reseed the slots from the decayed histogram, using bin centers for the
+  // color sums until real samples replace them.
+  constexpr float binWidth = 1 << MMCQ::RIGHT_SHIFT;
+  constexpr int mask = (1 << MMCQ::SIGNAL_BITS) - 1;
+  for (int index = 0; index < MMCQ::HISTOGRAM_SIZE; index++) {
+    float weight = histogram[index];
+    uint8_t box = boxOfBin[index];
+    if (weight <= 0.0f || box == NO_BOX) {
+      continue;
+    }
+    Slot& slot = slots[box];
+    slot.count += weight;
+    slot.rSum += weight * (((index >> (2 * MMCQ::SIGNAL_BITS)) & mask) + 0.5f) *
+                 binWidth;
+    slot.gSum +=
+        weight * (((index >> MMCQ::SIGNAL_BITS) & mask) + 0.5f) * binWidth;
+    slot.bSum += weight * ((index & mask) + 0.5f) * binWidth;
+  }
+
+  unassigned = 0.0f;
+  referencePopulation.resize(slots.size());
+  for (size_t i = 0; i < slots.size(); i++) {
+    referencePopulation[i] = total > 0.0f ? slots[i].count / total : 0.0f;
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Palette extraction over a sequence of similar frames (camera preview,
+// video). A decayed histogram is fed from a subsample of every frame and the
+// boxes of the last median cut are reused until the distribution drifts, so
+// most frames only pay for sampling. A new cut is warm-started from the
+// previous cuts and only re-splits the boxes whose population moved.
+class PaletteTracker {
+ public:
+  PaletteTracker(int maxColors, bool ignoreWhite);
+
+  std::vector<MMCQ::Color> track(const uint8_t* pixels, size_t size);
+  void reset();
+
+  int getMaxColors() const;
+  bool getIgnoreWhite() const;
+
+ private:
+  // Weight kept from the previous frames each time a frame is added.
+  static constexpr float DECAY = 0.8f;
+  // Fraction of the population that has to move between boxes, or land
+  // outside every box, before the histogram is cut again.
+  static constexpr float DRIFT_THRESHOLD = 0.15f;
+  // Most a previous cut's split of its box's population may move and still
+  // be kept by the next cut.
+  static constexpr float CUT_TOLERANCE = 0.1f;
+  static constexpr size_t SAMPLES_PER_FRAME = 16384;
+  // Decayed counts are scaled before being rounded into MMCQ's integer
+  // histogram so light bins survive the rounding.
+  static constexpr float HISTOGRAM_SCALE = 16.0f;
+  static constexpr uint8_t NO_BOX = 0xFF;
+
+  struct Slot {
+    float count;
+    float rSum;
+    float gSum;
+    float bSum;
+  };
+
+  void recut();
+  float makeDrift() const;
+  MMCQ::Color makeSlotColor(const Slot& slot, const MMCQ::Color& fallback) const;
+
+  int maxColors;
+  bool ignoreWhite;
+  size_t frameIndex = 0;
+
+  std::vector<float> histogram;
+  // Box owning each histogram bin, as an index into slots.
+  std::vector<uint8_t> boxOfBin;
+  std::vector<Slot> slots;
+  // Cuts of the last median cut, in the order they were made.
+  std::vector<MMCQ::Cut> cuts;
+  std::vector<float> referencePopulation;
+  std::vector<MMCQ::Color> palette;
+  float unassigned = 0.0f;
+  float total = 0.0f;
+};
@@ -0,0 +1,108 @@
+#include "ProgressiveQuantizer.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+ProgressiveQuantizer::Result ProgressiveQuantizer::quantize(
+    const std::vector<uint8_t>& pixels, int maxColors, bool ignoreWhite,
+    std::chrono::steady_clock::duration budget,
+    const std::function<void(const std::vector<MMCQ::Color>&)>&
+        onEarlyResult) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+
+  MMCQ::Histogram histogram = MMCQ::makeEmptyHistogram();
+
+  size_t pixelCount = pixels.size() / 4;
+  size_t pixelsUsed = 0;
+  std::vector<int> checkpoint;
+  size_t checkpointUsed = 0;
+  bool early = false;
+  Clock::duration cutDuration = Clock::duration::zero();
+  bool outOfTime = false;
+  int pass = 0;
+
+  for (; pass < PASS_COUNT && !outOfTime; pass++) {
+    size_t visited = 0;
+    for (size_t i = makePassOffset(pass); i < pixelCount; i += PASS_COUNT) {
+      // Leave room for the final cut, estimated by the early one if any.
+      if (++visited % CLOCK_INTERVAL == 0 &&
+          Clock::now() - start + cutDuration >= budget) {
+        outOfTime = true;
+        break;
+      }
+
+      const uint8_t* pixel = &pixels[i * 4];
+      uint8_t r = pixel[0];
+      uint8_t g = pixel[1];
+      uint8_t b = pixel[2];
+      if (MMCQ::isIgnoredPixel(r, g, b, pixel[3], ignoreWhite)) {
+        continue;
+      }
+
+      MMCQ::addSample(histogram, r, g, b);
+      pixelsUsed++;
+    }
+
+    // Passes 1, 2, 4, ... each double the sampling density, which is where
+    // two histograms are worth comparing.
+    int passesDone = pass + 1;
+    if (!outOfTime && !early && (passesDone & (passesDone - 1)) == 0 &&
+        passesDone < PASS_COUNT && pixelsUsed > 0) {
+      if (!checkpoint.empty() &&
+          makeDistance(histogram.counts, pixelsUsed, checkpoint,
+                       checkpointUsed) < STABLE_DISTANCE) {
+        Clock::time_point cutStart = Clock::now();
+        MMCQ::fitBounds(histogram);
+        auto colorMap = MMCQ::quantize(histogram, maxColors);
+        cutDuration = Clock::now() - cutStart;
+        if (colorMap) {
+          onEarlyResult(colorMap->makePalette());
+        }
+        early = true;
+      }
+      checkpoint = histogram.counts;
+      checkpointUsed = pixelsUsed;
+    }
+
+    if (Clock::now() - start + cutDuration >= budget) {
+      outOfTime = pass + 1 < PASS_COUNT;
+    }
+  }
+
+  Result result{{}, pixelsUsed, !outOfTime};
+  if (pixelsUsed == 0) {
+    return result;
+  }
+  MMCQ::fitBounds(histogram);
+  auto colorMap = MMCQ::quantize(histogram, maxColors);
+  if (colorMap) {
+    result.palette = colorMap->makePalette();
+  }
+  return result;
+}
+
+int ProgressiveQuantizer::makePassOffset(int pass) {
+  int offset = 0;
+  for (int bit = 0; bit < PASS_BITS; bit++) {
+    if (pass & (1 << bit)) {
+      offset |= 1 << (PASS_BITS - 1 - bit);
+    }
+  }
+  return offset;
+}
+
+double ProgressiveQuantizer::makeDistance(const std::vector<int>& histogram,
+                                          size_t total,
+                                          const std::vector<int>& previous,
+                                          size_t previousTotal) {
+  double scale = 1.0 / static_cast<double>(total);
+  double previousScale = 1.0 / static_cast<double>(previousTotal);
+  double distance = 0.0;
+  for (size_t i = 0; i < histogram.size(); i++) {
+    if (histogram[i] == 0 && previous[i] == 0) {
+      continue;
+    }
+    distance += std::abs(histogram[i] * scale - previous[i] * previousScale);
+  }
+  return distance;
+}
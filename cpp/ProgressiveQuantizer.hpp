@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Palette extraction under a time budget. Pixels are sampled in stratified
+// passes, each one halving the spacing of the samples taken so far, and the
+// palette is cut from whatever has been sampled when the budget runs out.
+class ProgressiveQuantizer {
+ public:
+  struct Result {
+    std::vector<MMCQ::Color> palette;
+    // Pixels that made it into the histogram.
+    size_t pixelsUsed;
+    // Whether every pixel was sampled before the budget ran out.
+    bool complete;
+  };
+
+  // onEarlyResult is called at most once, with the palette of the first
+  // histogram that stopped changing between two passes, unless sampling
+  // finishes first.
+  static Result quantize(
+      const std::vector<uint8_t>& pixels, int maxColors, bool ignoreWhite,
+      std::chrono::steady_clock::duration budget,
+      const std::function<void(const std::vector<MMCQ::Color>&)>&
+          onEarlyResult);
+
+ private:
+  // Pixels are split into PASS_COUNT interleaved strata, visited in
+  // bit-reversed order so every prefix of passes is evenly spread.
+  static constexpr int PASS_BITS = 8;
+  static constexpr int PASS_COUNT = 1 << PASS_BITS;
+  // Pixels visited between two looks at the clock.
+  static constexpr size_t CLOCK_INTERVAL = 4096;
+  // Largest L1 distance between the normalized histograms of two
+  // checkpoints for the histogram to count as stable.
+  static constexpr double STABLE_DISTANCE = 0.05;
+
+  static int makePassOffset(int pass);
+  static double makeDistance(const std::vector<int>& histogram, size_t total,
+                             const std::vector<int>& previous,
+                             size_t previousTotal);
+};
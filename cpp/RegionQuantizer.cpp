@@ -0,0 +1,114 @@
+#include "RegionQuantizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include "ThreadPool.hpp"
+
+std::vector<std::vector<MMCQ::Color>> RegionQuantizer::quantize(
+    const uint8_t* pixels, size_t size, const Layout& layout, int maxColors,
+    int quality, bool ignoreWhite) {
+  if (pixels == nullptr || layout.width < 1 || layout.height < 1 ||
+      layout.columns < 1 || layout.rows < 1 || quality < 1 ||
+      layout.edgeFraction < 0.0 || layout.edgeFraction > 0.5 ||
+      size / 4 != static_cast<size_t>(layout.width) * layout.height) {
+    return {};
+  }
+
+  const int width = layout.width;
+  const int height = layout.height;
+  const int columns = std::min(layout.columns, width);
+  const int rows = std::min(layout.rows, height);
+  const int tileCount = columns * rows;
+  const int edgeRows =
+      layout.edgeFraction > 0.0
+          ? std::max(1, static_cast<int>(std::lround(height *
+                                                     layout.edgeFraction)))
+          : 0;
+  const int regionCount = tileCount + (edgeRows > 0 ? 2 : 0);
+
+  // Tile of every column and row, so the sweep only adds two lookups.
+  std::vector<int> columnOf(width);
+  for (int x = 0; x < width; x++) {
+    columnOf[x] = static_cast<int>(static_cast<int64_t>(x) * columns / width);
+  }
+  std::vector<int> rowOf(height);
+  for (int y = 0; y < height; y++) {
+    rowOf[y] = static_cast<int>(static_cast<int64_t>(y) * rows / height) *
+               columns;
+  }
+
+  // Same sampling as MMCQ::quantize: every 4 * quality-th pixel.
+  const int step = 4 * quality;
+  const size_t pixelCount = size / 4;
+
+  std::vector<SparseHistogram> regions(regionCount);
+  SparseHistogram* top = edgeRows > 0 ? &regions[tileCount] : nullptr;
+  SparseHistogram* bottom = edgeRows > 0 ? &regions[tileCount + 1] : nullptr;
+
+  int x = 0;
+  int y = 0;
+  for (size_t i = 0; i < pixelCount; i += step) {
+    const uint8_t* pixel = &pixels[i * 4];
+    uint8_t r = pixel[0];
+    uint8_t g = pixel[1];
+    uint8_t b = pixel[2];
+    uint8_t a = pixel[3];
+    if (!MMCQ::isIgnoredPixel(r, g, b, a, ignoreWhite)) {
+      int index = MMCQ::makeColorIndexOf(r >> MMCQ::RIGHT_SHIFT,
+                                         g >> MMCQ::RIGHT_SHIFT,
+                                         b >> MMCQ::RIGHT_SHIFT);
+      addSample(regions[rowOf[y] + columnOf[x]], index);
+      if (y < edgeRows) {
+        addSample(*top, index);
+      }
+      if (y >= height - edgeRows) {
+        addSample(*bottom, index);
+      }
+    }
+
+    x += step;
+    while (x >= width) {
+      x -= width;
+      y++;
+    }
+  }
+
+  std::vector<std::vector<MMCQ::Color>> palettes(regionCount);
+  ThreadPool::shared().parallelFor(regionCount, [&](size_t region) {
+    std::vector<MMCQ::Bin> bins = makeBins(regions[region]);
+    std::vector<int>().swap(regions[region].arena);
+    if (bins.empty()) {
+      return;
+    }
+    auto colorMap = MMCQ::quantize(std::move(bins), maxColors);
+    if (colorMap) {
+      palettes[region] = colorMap->makePalette();
+    }
+  });
+  return palettes;
+}
+
+void RegionQuantizer::addSample(SparseHistogram& histogram, int index) {
+  int& offset = histogram.offsetOfPage[index >> PAGE_BITS];
+  if (offset < 0) {
+    offset = static_cast<int>(histogram.arena.size());
+    histogram.arena.resize(histogram.arena.size() + PAGE_SIZE, 0);
+  }
+  histogram.arena[offset + (index & (PAGE_SIZE - 1))]++;
+}
+
+std::vector<MMCQ::Bin> RegionQuantizer::makeBins(
+    const SparseHistogram& histogram) {
+  std::vector<MMCQ::Bin> bins;
+  for (int page = 0; page < PAGE_COUNT; page++) {
+    int offset = histogram.offsetOfPage[page];
+    if (offset < 0) {
+      continue;
+    }
+    for (int i = 0; i < PAGE_SIZE; i++) {
+      if (histogram.arena[offset + i] != 0) {
+        bins.push_back({page * PAGE_SIZE + i, histogram.arena[offset + i]});
+      }
+    }
+  }
+  return bins;
+}
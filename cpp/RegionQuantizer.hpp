@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Palettes for several regions of one image: an evenly split grid of tiles
+// and, optionally, bands along the top and bottom edges. The image is swept
+// once, every sample going to each region that contains it, and the regions
+// are then cut in parallel.
+class RegionQuantizer {
+ public:
+  struct Layout {
+    int width;
+    int height;
+    int columns;
+    int rows;
+    // Height of each edge band as a fraction of the image height; no edge
+    // bands are made when it is 0.
+    double edgeFraction;
+  };
+
+  // Returns the tile palettes in row-major order, followed by the top and
+  // bottom band palettes. Returns an empty list when the layout does not
+  // describe the pixel buffer.
+  static std::vector<std::vector<MMCQ::Color>> quantize(
+      const uint8_t* pixels, size_t size, const Layout& layout, int maxColors,
+      int quality, bool ignoreWhite);
+
+ private:
+  // Regions count their samples in a histogram split into pages of
+  // PAGE_SIZE bins, each allocated from an arena when its first sample
+  // lands, so a region costs memory in proportion to the colors it holds
+  // rather than to its pixels or a full histogram.
+  static constexpr int PAGE_BITS = 5;
+  static constexpr int PAGE_SIZE = 1 << PAGE_BITS;
+  static constexpr int PAGE_COUNT = MMCQ::HISTOGRAM_SIZE >> PAGE_BITS;
+
+  struct SparseHistogram {
+    // Arena offset of each page, or -1 while it holds no samples.
+    std::vector<int> offsetOfPage = std::vector<int>(PAGE_COUNT, -1);
+    std::vector<int> arena;
+  };
+
+  static void addSample(SparseHistogram& histogram, int index);
+  // Occupied bins, sorted by index.
+  static std::vector<MMCQ::Bin> makeBins(const SparseHistogram& histogram);
+};
@@ -0,0 +1,231 @@
+#include "SplitTree.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+SplitTree SplitTree::quantize(const std::vector<uint8_t>& pixels,
+                              int maxColors, int quality, bool ignoreWhite) {
+  if (auto exact = MMCQ::makeExactColorMap(pixels.data(), pixels.size(),
+                                           maxColors, quality, ignoreWhite)) {
+    return makeExactTree(exact->getVBoxes());
+  }
+
+  std::vector<MMCQ::Cut> cuts;
+  auto colorMap =
+      MMCQ::quantizeWithCuts(pixels, maxColors, quality, ignoreWhite, cuts);
+  SplitTree tree;
+  if (!colorMap || colorMap->getVBoxes().empty()) {
+    return tree;
+  }
+
+  tree.nodes.reserve(2 * cuts.size() + 1);
+  tree.parents.reserve(cuts.size());
+  tree.nodes.push_back(cuts.empty() ? colorMap->getVBoxes().front()
+                                    : cuts.front().parent);
+
+  // Populated leaves own disjoint slices of the bin list, so the start of a
+  // leaf's slice identifies it until it is cut. Empty leaves are never cut.
+  std::unordered_map<int, int> leafOfBin;
+  leafOfBin.emplace(tree.nodes[0].range.begin, 0);
+  for (const auto& cut : cuts) {
+    auto it = leafOfBin.find(cut.parent.range.begin);
+    if (it == leafOfBin.end()) {
+      throw std::runtime_error("Cut of an unknown box");
+    }
+    tree.parents.push_back(it->second);
+    leafOfBin.erase(it);
+    for (const auto& child : cut.children) {
+      if (child.count > 0) {
+        leafOfBin.emplace(child.range.begin,
+                          static_cast<int>(tree.nodes.size()));
+      }
+      tree.nodes.push_back(child);
+    }
+  }
+  return tree;
+}
+
+SplitTree SplitTree::makeExactTree(const std::vector<MMCQ::VBox>& colors) {
+  SplitTree tree;
+  if (colors.empty()) {
+    return tree;
+  }
+
+  // rest[i] stands for colors i and after: their bounds, total count and
+  // weighted average.
+  std::vector<MMCQ::VBox> rest(colors.size());
+  rest.back() = colors.back();
+  int64_t rSum = 0;
+  int64_t gSum = 0;
+  int64_t bSum = 0;
+  int64_t count = 0;
+  for (size_t i = colors.size(); i-- > 0;) {
+    const MMCQ::VBox& color = colors[i];
+    rSum += static_cast<int64_t>(color.average.r) * color.count;
+    gSum += static_cast<int64_t>(color.average.g) * color.count;
+    bSum += static_cast<int64_t>(color.average.b) * color.count;
+    count += color.count;
+    if (i + 1 == colors.size()) {
+      continue;
+    }
+
+    MMCQ::VBox& node = rest[i];
+    const MMCQ::VBox& next = rest[i + 1];
+    node.rMin = std::min(color.rMin, next.rMin);
+    node.rMax = std::max(color.rMax, next.rMax);
+    node.gMin = std::min(color.gMin, next.gMin);
+    node.gMax = std::max(color.gMax, next.gMax);
+    node.bMin = std::min(color.bMin, next.bMin);
+    node.bMax = std::max(color.bMax, next.bMax);
+    node.range = {0, 0};
+    node.count = static_cast<int>(count);
+    node.volume = (node.rMax - node.rMin + 1) * (node.gMax - node.gMin + 1) *
+                  (node.bMax - node.bMin + 1);
+    node.average = MMCQ::Color(static_cast<uint8_t>((rSum + count / 2) / count),
+                               static_cast<uint8_t>((gSum + count / 2) / count),
+                               static_cast<uint8_t>((bSum + count / 2) / count));
+  }
+
+  // Cut i takes the i-th most populated color off the rest, so the leaves
+  // after k - 1 cuts are the first k - 1 colors and the average of the others.
+  tree.nodes.reserve(2 * colors.size() - 1);
+  tree.parents.reserve(colors.size() - 1);
+  tree.nodes.push_back(rest[0]);
+  for (size_t i = 0; i + 1 < colors.size(); i++) {
+    tree.parents.push_back(static_cast<int>(tree.nodes.size()) - 1);
+    tree.nodes.push_back(colors[i]);
+    tree.nodes.push_back(rest[i + 1]);
+  }
+  return tree;
+}
+
+int SplitTree::getMaxColors() const {
+  return nodes.empty() ? 0 : static_cast<int>(parents.size()) + 1;
+}
+
+std::vector<MMCQ::Color> SplitTree::makePalette(int colorCount) const {
+  int count = std::clamp(colorCount, 0, getMaxColors());
+  if (count == 0) {
+    return {};
+  }
+
+  // Only the first 2k - 1 nodes exist after k - 1 cuts.
+  std::vector<bool> isLeaf(2 * count - 1, true);
+  for (int i = 0; i < count - 1; i++) {
+    isLeaf[parents[i]] = false;
+  }
+  std::vector<const MMCQ::VBox*> leaves;
+  leaves.reserve(count);
+  for (size_t node = 0; node < isLeaf.size(); node++) {
+    if (isLeaf[node]) {
+      leaves.push_back(&nodes[node]);
+    }
+  }
+  // In quantize's order, so the full-size palette is the one quantize gave.
+  std::stable_sort(leaves.begin(), leaves.end(),
+                   [](const MMCQ::VBox* a, const MMCQ::VBox* b) {
+                     return MMCQ::compareByProduct(*b, *a);
+                   });
+
+  std::vector<MMCQ::Color> palette;
+  palette.reserve(leaves.size());
+  for (const auto* leaf : leaves) {
+    palette.push_back(leaf->average);
+  }
+  return palette;
+}
+
+std::vector<uint8_t> SplitTree::serialize() const {
+  std::vector<uint8_t> out(sizeof(MAGIC));
+  std::memcpy(out.data(), &MAGIC, sizeof(MAGIC));
+  out.push_back(VERSION);
+  if (nodes.empty()) {
+    return out;
+  }
+
+  writeNode(out, nodes[0]);
+  for (size_t i = 0; i < parents.size(); i++) {
+    uint32_t parent = static_cast<uint32_t>(parents[i]);
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&parent),
+               reinterpret_cast<const uint8_t*>(&parent) + sizeof(parent));
+    writeNode(out, nodes[2 * i + 1]);
+    writeNode(out, nodes[2 * i + 2]);
+  }
+  return out;
+}
+
+SplitTree SplitTree::deserialize(const uint8_t* data, size_t size) {
+  constexpr size_t headerSize = sizeof(MAGIC) + 1;
+  constexpr size_t cutSize = sizeof(uint32_t) + 2 * NODE_SIZE;
+  if (data == nullptr || size < headerSize) {
+    throw std::runtime_error("Invalid palette tree data");
+  }
+  uint32_t magic;
+  std::memcpy(&magic, data, sizeof(magic));
+  if (magic != MAGIC || data[sizeof(MAGIC)] != VERSION) {
+    throw std::runtime_error("Invalid palette tree data");
+  }
+
+  SplitTree tree;
+  if (size == headerSize) {
+    return tree;
+  }
+  if (size < headerSize + NODE_SIZE ||
+      (size - headerSize - NODE_SIZE) % cutSize != 0) {
+    throw std::runtime_error("Invalid palette tree data");
+  }
+
+  size_t cutCount = (size - headerSize - NODE_SIZE) / cutSize;
+  tree.nodes.reserve(2 * cutCount + 1);
+  tree.parents.reserve(cutCount);
+  tree.nodes.push_back(readNode(data + headerSize));
+
+  // Every cut must split a leaf that already exists.
+  std::vector<bool> isCut(2 * cutCount + 1, false);
+  const uint8_t* cut = data + headerSize + NODE_SIZE;
+  for (size_t i = 0; i < cutCount; i++, cut += cutSize) {
+    uint32_t parent;
+    std::memcpy(&parent, cut, sizeof(parent));
+    if (parent >= tree.nodes.size() || isCut[parent]) {
+      throw std::runtime_error("Invalid palette tree data");
+    }
+    isCut[parent] = true;
+    tree.parents.push_back(static_cast<int>(parent));
+    tree.nodes.push_back(readNode(cut + sizeof(parent)));
+    tree.nodes.push_back(readNode(cut + sizeof(parent) + NODE_SIZE));
+  }
+  return tree;
+}
+
+void SplitTree::writeNode(std::vector<uint8_t>& out,
+                          const MMCQ::VBox& node) {
+  uint32_t count = static_cast<uint32_t>(node.count);
+  out.insert(out.end(),
+             {node.average.r, node.average.g, node.average.b, node.rMin,
+              node.rMax, node.gMin, node.gMax, node.bMin, node.bMax});
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(&count),
+             reinterpret_cast<const uint8_t*>(&count) + sizeof(count));
+}
+
+MMCQ::VBox SplitTree::readNode(const uint8_t* data) {
+  uint32_t count;
+  std::memcpy(&count, data + 9, sizeof(count));
+
+  // Ranges refer to the bins of the original cut and are not kept.
+  MMCQ::VBox node{};
+  node.average = MMCQ::Color(data[0], data[1], data[2]);
+  node.rMin = data[3];
+  node.rMax = data[4];
+  node.gMin = data[5];
+  node.gMax = data[6];
+  node.bMin = data[7];
+  node.bMax = data[8];
+  node.range = {0, 0};
+  node.count = static_cast<int>(std::min<uint32_t>(
+      count, std::numeric_limits<int>::max()));
+  node.volume = (node.rMax - node.rMin + 1) * (node.gMax - node.gMin + 1) *
+                (node.bMax - node.bMin + 1);
+  return node;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MMCQ.hpp"
+
+// The median cuts of one quantization, recorded as a binary tree so a
+// palette of any size up to the recorded one is read back without cutting
+// again. Node 0 is the box around the whole histogram; cut i splits a leaf
+// into nodes 2i + 1 and 2i + 2, so the palette of k colors is the leaves
+// left after the first k - 1 cuts. Images with no more colors than the
+// recorded size are recorded as cuts that each take off one exact color.
+// The full-size palette is the one MMCQ::quantize gives for the recorded
+// size; a smaller one is what the first cuts left, which can differ from
+// what quantize would cut for that size.
+class SplitTree {
+ public:
+  // Returns an empty tree when there is nothing to quantize.
+  static SplitTree quantize(const std::vector<uint8_t>& pixels, int maxColors,
+                            int quality, bool ignoreWhite);
+
+  // Most colors a palette read from this tree can have.
+  int getMaxColors() const;
+
+  // Colors of the leaves after colorCount - 1 cuts, in MMCQ::quantize's
+  // order. colorCount is clamped to getMaxColors().
+  std::vector<MMCQ::Color> makePalette(int colorCount) const;
+
+  std::vector<uint8_t> serialize() const;
+  // Throws std::runtime_error when the data was not written by serialize.
+  static SplitTree deserialize(const uint8_t* data, size_t size);
+
+ private:
+  static constexpr uint32_t MAGIC = 0x5453504E;  // "NPST"
+  static constexpr uint8_t VERSION = 1;
+  // Average, bounds and count.
+  static constexpr size_t NODE_SIZE = 3 + 6 + sizeof(uint32_t);
+
+  // colors is the exact color map's boxes, most populated first.
+  static SplitTree makeExactTree(const std::vector<MMCQ::VBox>& colors);
+
+  static void writeNode(std::vector<uint8_t>& out, const MMCQ::VBox& node);
+  static MMCQ::VBox readNode(const uint8_t* data);
+
+  std::vector<MMCQ::VBox> nodes;
+  // Node split by each cut, in cut order.
+  std::vector<int> parents;
+};
@@ -0,0 +1,218 @@
+#include "Swatches.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+std::string Swatches::TextColor::toString() const {
+  char alphaString[8];
+  std::snprintf(alphaString, sizeof(alphaString), "%.2f", alpha);
+  return "rgba(" + std::to_string(color.r) + "," + std::to_string(color.g) +
+         "," + std::to_string(color.b) + "," + alphaString + ")";
+}
+
+std::vector<Swatches::Swatch> Swatches::classify(
+    const MMCQ::ColorMap& colorMap) {
+  const auto& vboxes = colorMap.getVBoxes();
+  if (vboxes.empty()) {
+    return {};
+  }
+
+  int maxPopulation = 0;
+  size_t dominant = 0;
+  std::vector<Hsl> hsl(vboxes.size());
+  for (size_t i = 0; i < vboxes.size(); i++) {
+    hsl[i] = makeHsl(vboxes[i].average);
+    if (vboxes[i].count > maxPopulation) {
+      maxPopulation = vboxes[i].count;
+      dominant = i;
+    }
+  }
+
+  std::vector<Swatch> swatches;
+  std::vector<bool> used(vboxes.size(), false);
+  for (const auto& target : getTargets()) {
+    int best = -1;
+    float bestScore = 0;
+    for (size_t i = 0; i < vboxes.size(); i++) {
+      const Hsl& color = hsl[i];
+      if (used[i] || isFiltered(color) ||
+          color.saturation < target.minSaturation ||
+          color.saturation > target.maxSaturation ||
+          color.lightness < target.minLightness ||
+          color.lightness > target.maxLightness) {
+        continue;
+      }
+      float score =
+          SATURATION_WEIGHT *
+              (1 - std::abs(color.saturation - target.targetSaturation)) +
+          LIGHTNESS_WEIGHT *
+              (1 - std::abs(color.lightness - target.targetLightness)) +
+          POPULATION_WEIGHT *
+              (static_cast<float>(vboxes[i].count) / maxPopulation);
+      if (best < 0 || score > bestScore) {
+        best = static_cast<int>(i);
+        bestScore = score;
+      }
+    }
+    if (best >= 0) {
+      used[best] = true;
+      swatches.push_back({target.role, vboxes[best].average,
+                          vboxes[best].count, {}, {}});
+    }
+  }
+  swatches.push_back({Role::Dominant, vboxes[dominant].average,
+                      vboxes[dominant].count, {}, {}});
+
+  for (auto& swatch : swatches) {
+    makeTextColors(swatch.color, swatch);
+  }
+  return swatches;
+}
+
+const char* Swatches::makeRoleName(Role role) {
+  switch (role) {
+    case Role::Vibrant:
+      return "vibrant";
+    case Role::LightVibrant:
+      return "lightVibrant";
+    case Role::DarkVibrant:
+      return "darkVibrant";
+    case Role::Muted:
+      return "muted";
+    case Role::LightMuted:
+      return "lightMuted";
+    case Role::DarkMuted:
+      return "darkMuted";
+    case Role::Dominant:
+    default:
+      return "dominant";
+  }
+}
+
+const std::array<Swatches::Target, 6>& Swatches::getTargets() {
+  // AndroidX Palette's default targets, in the order it fills them.
+  static const std::array<Target, 6> targets = {{
+      {Role::LightVibrant, 0.35f, 1.0f, 1.0f, 0.55f, 0.74f, 1.0f},
+      {Role::Vibrant, 0.35f, 1.0f, 1.0f, 0.3f, 0.5f, 0.7f},
+      {Role::DarkVibrant, 0.35f, 1.0f, 1.0f, 0.0f, 0.26f, 0.45f},
+      {Role::LightMuted, 0.0f, 0.3f, 0.4f, 0.55f, 0.74f, 1.0f},
+      {Role::Muted, 0.0f, 0.3f, 0.4f, 0.3f, 0.5f, 0.7f},
+      {Role::DarkMuted, 0.0f, 0.3f, 0.4f, 0.0f, 0.26f, 0.45f},
+  }};
+  return targets;
+}
+
+const std::array<float, 256>& Swatches::getLinearTable() {
+  static const std::array<float, 256> table = []() {
+    std::array<float, 256> table{};
+    for (int i = 0; i < 256; i++) {
+      float value = i / 255.0f;
+      table[i] = value <= 0.03928f
+                     ? value / 12.92f
+                     : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+  }();
+  return table;
+}
+
+Swatches::Hsl Swatches::makeHsl(const MMCQ::Color& color) {
+  float r = color.r / 255.0f;
+  float g = color.g / 255.0f;
+  float b = color.b / 255.0f;
+  float max = std::max({r, g, b});
+  float min = std::min({r, g, b});
+  float delta = max - min;
+  float lightness = (max + min) / 2;
+  if (delta == 0) {
+    return {0, 0, lightness};
+  }
+
+  float hue;
+  if (max == r) {
+    hue = std::fmod((g - b) / delta, 6.0f);
+  } else if (max == g) {
+    hue = (b - r) / delta + 2;
+  } else {
+    hue = (r - g) / delta + 4;
+  }
+  hue *= 60;
+  if (hue < 0) {
+    hue += 360;
+  }
+  float saturation = delta / (1 - std::abs(2 * lightness - 1));
+  return {hue, saturation, lightness};
+}
+
+bool Swatches::isFiltered(const Hsl& hsl) {
+  return hsl.lightness <= 0.05f || hsl.lightness >= 0.95f ||
+         (hsl.hue >= 10 && hsl.hue <= 37 && hsl.saturation <= 0.82f);
+}
+
+float Swatches::makeLuminance(const MMCQ::Color& color) {
+  const auto& linear = getLinearTable();
+  return 0.2126f * linear[color.r] + 0.7152f * linear[color.g] +
+         0.0722f * linear[color.b];
+}
+
+float Swatches::makeContrast(const MMCQ::Color& foreground, float alpha,
+                             const MMCQ::Color& background) {
+  auto blend = [alpha](uint8_t front, uint8_t back) {
+    return static_cast<uint8_t>(
+        std::lround(front * alpha + back * (1 - alpha)));
+  };
+  MMCQ::Color composite(blend(foreground.r, background.r),
+                        blend(foreground.g, background.g),
+                        blend(foreground.b, background.b));
+  float a = makeLuminance(composite) + 0.05f;
+  float b = makeLuminance(background) + 0.05f;
+  return std::max(a, b) / std::min(a, b);
+}
+
+float Swatches::makeMinimumAlpha(const MMCQ::Color& foreground,
+                                 const MMCQ::Color& background, float ratio) {
+  if (makeContrast(foreground, 1, background) < ratio) {
+    return -1;
+  }
+
+  float low = 0;
+  float high = 1;
+  for (int i = 0; i < ALPHA_SEARCH_STEPS; i++) {
+    float alpha = (low + high) / 2;
+    if (makeContrast(foreground, alpha, background) < ratio) {
+      low = alpha;
+    } else {
+      high = alpha;
+    }
+  }
+  return high;
+}
+
+void Swatches::makeTextColors(const MMCQ::Color& background, Swatch& swatch) {
+  const MMCQ::Color white(255, 255, 255);
+  const MMCQ::Color black(0, 0, 0);
+
+  float lightBody = makeMinimumAlpha(white, background, MIN_CONTRAST_BODY_TEXT);
+  float lightTitle =
+      makeMinimumAlpha(white, background, MIN_CONTRAST_TITLE_TEXT);
+  if (lightBody >= 0 && lightTitle >= 0) {
+    swatch.bodyText = {white, lightBody};
+    swatch.titleText = {white, lightTitle};
+    return;
+  }
+
+  float darkBody = makeMinimumAlpha(black, background, MIN_CONTRAST_BODY_TEXT);
+  float darkTitle =
+      makeMinimumAlpha(black, background, MIN_CONTRAST_TITLE_TEXT);
+  if (darkBody >= 0 && darkTitle >= 0) {
+    swatch.bodyText = {black, darkBody};
+    swatch.titleText = {black, darkTitle};
+    return;
+  }
+
+  // Neither alone fits both sizes, so each gets whichever text works.
+  swatch.bodyText =
+      lightBody >= 0 ? TextColor{white, lightBody} : TextColor{black, darkBody};
+  swatch.titleText = lightTitle >= 0 ? TextColor{white, lightTitle}
+                                     : TextColor{black, darkTitle};
+}
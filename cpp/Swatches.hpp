@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include "MMCQ.hpp"
+
+// Role-tagged swatches in the manner of AndroidX Palette: the boxes of a
+// ColorMap are scored against vibrant and muted targets at three lightness
+// levels, and each swatch gets white or black title and body text at the
+// lowest alpha that keeps it readable. Works on the boxes alone, so the cost
+// does not depend on the image size.
+class Swatches {
+ public:
+  // Colors to quantize an image to before classifying, as AndroidX Palette
+  // does by default.
+  static constexpr int MAX_COLORS = 16;
+
+  enum class Role {
+    Vibrant,
+    LightVibrant,
+    DarkVibrant,
+    Muted,
+    LightMuted,
+    DarkMuted,
+    Dominant
+  };
+
+  // White or black at an alpha between 0 and 1.
+  struct TextColor {
+    MMCQ::Color color;
+    float alpha;
+
+    std::string toString() const;
+  };
+
+  struct Swatch {
+    Role role;
+    MMCQ::Color color;
+    int population;
+    TextColor titleText;
+    TextColor bodyText;
+  };
+
+  // Roles with no fitting box are left out. Each box fills at most one of
+  // the vibrant and muted roles; the dominant swatch is the most populous
+  // box.
+  static std::vector<Swatch> classify(const MMCQ::ColorMap& colorMap);
+
+  static const char* makeRoleName(Role role);
+
+ private:
+  struct Target {
+    Role role;
+    float minSaturation;
+    float targetSaturation;
+    float maxSaturation;
+    float minLightness;
+    float targetLightness;
+    float maxLightness;
+  };
+
+  struct Hsl {
+    float hue;
+    float saturation;
+    float lightness;
+  };
+
+  static constexpr float MIN_CONTRAST_TITLE_TEXT = 3.0f;
+  static constexpr float MIN_CONTRAST_BODY_TEXT = 4.5f;
+  static constexpr float SATURATION_WEIGHT = 0.24f;
+  static constexpr float LIGHTNESS_WEIGHT = 0.52f;
+  static constexpr float POPULATION_WEIGHT = 0.24f;
+  // Alpha steps tried when searching for the lowest readable text alpha.
+  static constexpr int ALPHA_SEARCH_STEPS = 10;
+
+  static const std::array<Target, 6>& getTargets();
+  // Relative luminance of every 8-bit sRGB channel value.
+  static const std::array<float, 256>& getLinearTable();
+
+  static Hsl makeHsl(const MMCQ::Color& color);
+  // Near black, near white, or on the skin-tone I line.
+  static bool isFiltered(const Hsl& hsl);
+  static float makeLuminance(const MMCQ::Color& color);
+  static float makeContrast(const MMCQ::Color& foreground, float alpha,
+                            const MMCQ::Color& background);
+  // Lowest alpha at which foreground over background reaches ratio, or a
+  // negative value when even opaque text falls short.
+  static float makeMinimumAlpha(const MMCQ::Color& foreground,
+                                const MMCQ::Color& background, float ratio);
+  static void makeTextColors(const MMCQ::Color& background, Swatch& swatch);
+};
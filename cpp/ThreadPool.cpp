@@ -0,0 +1,162 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+
+namespace {
+// Index of the pool queue owned by the current thread, or SIZE_MAX when the
+// thread is not a pool worker.
+thread_local size_t currentQueue = SIZE_MAX;
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  queues.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    threads.emplace_back([this, i]() { run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool(
+      std::max(std::thread::hardware_concurrency(), 1u) - 1);
+  return pool;
+}
+
+size_t ThreadPool::size() const { return threads.size(); }
+
+void ThreadPool::submit(std::function<void()> task) {
+  if (threads.empty()) {
+    task();
+    return;
+  }
+
+  size_t index = currentQueue;
+  if (index >= queues.size()) {
+    index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  pending.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  condition.notify_one();
+}
+
+bool ThreadPool::popTask(size_t index, std::function<void()>& task) {
+  {
+    Queue& own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      pending.fetch_sub(1);
+      return true;
+    }
+  }
+
+  for (size_t offset = 1; offset < queues.size(); offset++) {
+    Queue& victim = *queues[(index + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      pending.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run(size_t index) {
+  currentQueue = index;
+  std::function<void()> task;
+
+  while (true) {
+    if (popTask(index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return stopping || pending.load() > 0; });
+    if (stopping && pending.load() == 0) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)>& body) {
+  if (count == 0) {
+    return;
+  }
+  if (count == 1 || threads.empty()) {
+    for (size_t i = 0; i < count; i++) {
+      body(i);
+    }
+    return;
+  }
+
+  struct Job {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+  };
+  auto job = std::make_shared<Job>();
+
+  // Helpers that start after every index has been claimed return without
+  // touching body, so body only has to outlive this call.
+  auto work = [job, count, &body]() {
+    while (true) {
+      size_t i = job->next.fetch_add(1);
+      if (i >= count) {
+        return;
+      }
+      try {
+        body(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (!job->error) {
+          job->error = std::current_exception();
+        }
+      }
+      if (job->done.fetch_add(1) + 1 == count) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = std::min(count - 1, threads.size());
+  for (size_t i = 0; i < helpers; i++) {
+    submit(work);
+  }
+  work();
+
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->finished.wait(lock, [&]() { return job->done.load() == count; });
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. Workers run their
+// own tasks newest-first and steal the oldest task of another worker when
+// their deque runs dry.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Process-wide pool with one worker per core besides the calling thread.
+  static ThreadPool& shared();
+
+  size_t size() const;
+
+  void submit(std::function<void()> task);
+
+  // Calls body(i) for every i in [0, count) and returns once all calls have
+  // finished. The calling thread takes part in the loop, so parallelFor may
+  // be nested inside a task. The first exception thrown by body is rethrown
+  // after the remaining calls complete.
+  void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool popTask(size_t index, std::function<void()>& task);
+  void run(size_t index);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::atomic<size_t> pending{0};
+  std::atomic<size_t> nextQueue{0};
+  bool stopping = false;
+};
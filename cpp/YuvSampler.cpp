@@ -0,0 +1,96 @@
+#include "YuvSampler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+MMCQ::Histogram YuvSampler::makeHistogram(const Frame& frame, Matrix matrix,
+                                          bool fullRange, int quality,
+                                          bool ignoreWhite,
+                                          const CancellationToken* token) {
+  int width = frame.width;
+  int height = frame.height;
+  int chromaWidth = (width + 1) / 2;
+  int chromaHeight = (height + 1) / 2;
+  if (width <= 0 || height <= 0 || quality < 1 ||
+      !isValidPlane(frame.y, width, height) ||
+      !isValidPlane(frame.u, chromaWidth, chromaHeight) ||
+      !isValidPlane(frame.v, chromaWidth, chromaHeight)) {
+    throw std::runtime_error("Invalid YUV frame");
+  }
+
+  const Coefficients& k =
+      matrix == Matrix::BT709 ? (fullRange ? BT709_FULL : BT709_VIDEO)
+                              : (fullRange ? BT601_FULL : BT601_VIDEO);
+
+  MMCQ::Histogram histogram = MMCQ::makeEmptyHistogram();
+
+  // Each chroma row is gathered into flat arrays first, so the conversion
+  // runs over contiguous ints without branches and can be vectorized.
+  int columns = (chromaWidth + quality - 1) / quality;
+  std::vector<int> luma(columns);
+  std::vector<int> blue(columns);
+  std::vector<int> red(columns);
+  std::vector<uint8_t> r(columns);
+  std::vector<uint8_t> g(columns);
+  std::vector<uint8_t> b(columns);
+
+  for (int cy = 0; cy < chromaHeight; cy++) {
+    if (token && cy % CANCELLATION_ROWS == 0) {
+      token->throwIfCancelled();
+    }
+
+    // Offsets are taken in size_t: the planes were checked to hold them,
+    // but a product of strides can exceed int.
+    const uint8_t* yRow0 =
+        frame.y.data + static_cast<size_t>(2 * cy) * frame.y.rowStride;
+    const uint8_t* yRow1 =
+        frame.y.data +
+        static_cast<size_t>(std::min(2 * cy + 1, height - 1)) *
+            frame.y.rowStride;
+    const uint8_t* uRow =
+        frame.u.data + static_cast<size_t>(cy) * frame.u.rowStride;
+    const uint8_t* vRow =
+        frame.v.data + static_cast<size_t>(cy) * frame.v.rowStride;
+    for (int c = 0; c < columns; c++) {
+      int cx = c * quality;
+      size_t x0 = static_cast<size_t>(2 * cx) * frame.y.pixelStride;
+      size_t x1 = static_cast<size_t>(std::min(2 * cx + 1, width - 1)) *
+                  frame.y.pixelStride;
+      luma[c] = (yRow0[x0] + yRow0[x1] + yRow1[x0] + yRow1[x1] + 2) >> 2;
+      blue[c] = uRow[static_cast<size_t>(cx) * frame.u.pixelStride] - 128;
+      red[c] = vRow[static_cast<size_t>(cx) * frame.v.pixelStride] - 128;
+    }
+
+    for (int c = 0; c < columns; c++) {
+      int scaled = (luma[c] - k.yOffset) * k.yScale + 128;
+      r[c] = static_cast<uint8_t>(
+          std::clamp((scaled + k.rv * red[c]) >> 8, 0, 255));
+      g[c] = static_cast<uint8_t>(std::clamp(
+          (scaled - k.gu * blue[c] - k.gv * red[c]) >> 8, 0, 255));
+      b[c] = static_cast<uint8_t>(
+          std::clamp((scaled + k.bu * blue[c]) >> 8, 0, 255));
+    }
+
+    for (int c = 0; c < columns; c++) {
+      if (!MMCQ::isIgnoredPixel(r[c], g[c], b[c], 255, ignoreWhite)) {
+        MMCQ::addSample(histogram, r[c], g[c], b[c]);
+      }
+    }
+  }
+  MMCQ::fitBounds(histogram);
+  return histogram;
+}
+
+bool YuvSampler::isValidPlane(const Plane& plane, int width, int height) {
+  if (plane.data == nullptr || plane.pixelStride < 1 || plane.rowStride < 1) {
+    return false;
+  }
+  // In 64 bits, which hold any product of two ints, so a stride near
+  // INT_MAX cannot wrap past the checks; size_t is 32 bits on some ABIs.
+  uint64_t rowEnd = static_cast<uint64_t>(width - 1) * plane.pixelStride;
+  if (static_cast<uint64_t>(plane.rowStride) < rowEnd + 1) {
+    return false;
+  }
+  uint64_t last = static_cast<uint64_t>(height - 1) * plane.rowStride + rowEnd;
+  return last < static_cast<uint64_t>(plane.size);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "CancellationToken.hpp"
+#include "MMCQ.hpp"
+
+// Histograms YUV 4:2:0 camera frames (I420, NV12, NV21) without an RGBA
+// copy. Sampling runs on the chroma grid: each sampled chroma sample is read
+// once, paired with the mean of the 2x2 luma block it covers, and converted
+// with fixed-point BT.601 or BT.709 coefficients straight into a bin index.
+class YuvSampler {
+ public:
+  enum class Matrix { BT601, BT709 };
+
+  // One plane of the frame. Semi-planar frames are described by two planes
+  // over the same interleaved bytes with a pixel stride of 2.
+  struct Plane {
+    const uint8_t* data;
+    size_t size;
+    int rowStride;
+    int pixelStride;
+  };
+
+  struct Frame {
+    int width;
+    int height;
+    Plane y;
+    Plane u;
+    Plane v;
+  };
+
+  // Samples every quality-th chroma sample of every chroma row, about as
+  // many pixels as MMCQ samples from the same frame in RGBA. fullRange
+  // selects 0-255 luma instead of video range 16-235. Throws
+  // std::runtime_error when the planes are too small for the frame.
+  static MMCQ::Histogram makeHistogram(
+      const Frame& frame, Matrix matrix, bool fullRange, int quality,
+      bool ignoreWhite, const CancellationToken* token = nullptr);
+
+ private:
+  // Conversion in 8 fractional bits: luma is offset and scaled, and the
+  // chroma terms are added with the signs of the standard equations.
+  struct Coefficients {
+    int yOffset;
+    int yScale;
+    int rv;
+    int gu;
+    int gv;
+    int bu;
+  };
+
+  static constexpr Coefficients BT601_VIDEO = {16, 298, 409, 100, 208, 516};
+  static constexpr Coefficients BT601_FULL = {0, 256, 359, 88, 183, 454};
+  static constexpr Coefficients BT709_VIDEO = {16, 298, 459, 55, 136, 541};
+  static constexpr Coefficients BT709_FULL = {0, 256, 403, 48, 120, 475};
+
+  // Chroma rows between two cancellation checks.
+  static constexpr int CANCELLATION_ROWS = 64;
+
+  static bool isValidPlane(const Plane& plane, int width, int height);
+};
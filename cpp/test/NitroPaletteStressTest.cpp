@@ -0,0 +1,324 @@
+// Calls one NitroPalette from many threads at once, as several JS runtimes
+// sharing the hybrid object would, and checks every result against the same
+// call made serially beforehand. Also checks that in-flight memory is fully
+// released, that duplicate request ids are rejected, that palettes are no
+// longer than requested, that a palette tree read at full size matches the
+// palette it was cut for and that two instances can share one cache
+// directory, a reader seeing the other's writes across a rehash.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "NitroPalette.hpp"
+#include "PaletteCache.hpp"
+#include "PaletteScheduler.hpp"
+#include "SplitTree.hpp"
+
+using margelo::nitro::ArrayBuffer;
+using margelo::nitro::nitropalette::HybridNitroPaletteSpec;
+using margelo::nitro::nitropalette::NitroPalette;
+
+// The JS bindings are not under test.
+void HybridNitroPaletteSpec::loadHybridMethods() {}
+
+namespace {
+
+constexpr int IMAGE_COUNT = 8;
+constexpr int IMAGE_SIZE = 128;
+constexpr int THREAD_COUNT = 8;
+constexpr int ROUNDS = 12;
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+  if (!condition) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+std::shared_ptr<ArrayBuffer> makeImage(int seed) {
+  std::mt19937 random(seed);
+  auto image = ArrayBuffer::allocate(IMAGE_SIZE * IMAGE_SIZE * 4);
+  uint8_t* pixels = image->data();
+  for (size_t i = 0; i < image->size(); i += 4) {
+    pixels[i] = static_cast<uint8_t>(random() % 128 + seed * 16);
+    pixels[i + 1] = static_cast<uint8_t>(random() % 256);
+    pixels[i + 2] = static_cast<uint8_t>(seed * 30);
+    pixels[i + 3] = 255;
+  }
+  return image;
+}
+
+struct Expected {
+  std::vector<std::string> colors;
+  std::vector<std::string> histogramColors;
+  std::vector<std::vector<std::string>> regions;
+  std::vector<std::string> analysis;
+};
+
+Expected expect(NitroPalette& palette,
+                const std::shared_ptr<ArrayBuffer>& image) {
+  return {palette.extractColors(image, 6, 5, false),
+          palette.extractColorsFromHistograms(
+              {palette.makeHistogram(image, 5, false)}, {}, 6),
+          palette.extractRegionColors(image, IMAGE_SIZE, IMAGE_SIZE, 2, 2, 0.1,
+                                      4, 5, false),
+          palette.analyzeImage(image, IMAGE_SIZE, IMAGE_SIZE, 1, 6, 5, false)
+              .palette};
+}
+
+void testConcurrentCalls(const std::string& cacheDirectory) {
+  auto palette = std::make_shared<NitroPalette>();
+  palette->configureCache(cacheDirectory);
+  size_t baseline = palette->getExternalMemorySize();
+
+  std::vector<std::shared_ptr<ArrayBuffer>> images;
+  std::vector<Expected> expected;
+  for (int i = 0; i < IMAGE_COUNT; i++) {
+    images.push_back(makeImage(i));
+    expected.push_back(expect(*palette, images.back()));
+  }
+
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREAD_COUNT; t++) {
+    threads.emplace_back([&, t] {
+      for (int round = 0; round < ROUNDS; round++) {
+        int i = (t + round) % IMAGE_COUNT;
+        const auto& image = images[i];
+        Expected got = expect(*palette, image);
+        if (got.colors != expected[i].colors ||
+            got.histogramColors != expected[i].histogramColors ||
+            got.regions != expected[i].regions ||
+            got.analysis != expected[i].analysis ||
+            palette->extractColorsCached("image-" + std::to_string(i), image,
+                                         6, 5, false) != expected[i].colors ||
+            palette
+                    ->extractColorsAsync(image, 6, 5, false,
+                                         palette->createRequestId(), round % 3)
+                    ->await() != expected[i].colors) {
+          mismatches++;
+        }
+        palette->trackFrame(image, 5, false);
+        palette->extractSwatches(image, 5, false);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  check(mismatches == 0, "concurrent calls return the serial results");
+
+  check(palette->getExternalMemorySize() == baseline,
+        "in-flight memory is released after every call");
+}
+
+void testPaletteLengths(const std::string& cacheDirectory) {
+  // MMCQ leaves more boxes than asked for; every path must cut them off.
+  constexpr int COUNT = 5;
+  auto palette = std::make_shared<NitroPalette>();
+  palette->configureCache(cacheDirectory);
+  auto image = makeImage(3);
+  auto fits = [](const std::vector<std::string>& colors) {
+    return !colors.empty() && colors.size() <= COUNT;
+  };
+
+  bool regionsFit = true;
+  for (const auto& region : palette->extractRegionColors(
+           image, IMAGE_SIZE, IMAGE_SIZE, 2, 2, 0.1, COUNT, 5, false)) {
+    regionsFit = regionsFit && fits(region);
+  }
+  check(fits(palette->extractColors(image, COUNT, 5, false)) &&
+            fits(palette
+                     ->extractColorsAsync(image, COUNT, 5, false,
+                                          palette->createRequestId(), 0)
+                     ->await()) &&
+            fits(palette
+                     ->extractColorsWithBudget(
+                         image, COUNT, false, 1000,
+                         [](const std::vector<std::string>&) {})
+                     ->await()
+                     .colors) &&
+            fits(palette->extractColorsFromHistograms(
+                {palette->makeHistogram(image, 5, false)}, {}, COUNT)) &&
+            fits(palette->extractCollectionColors({image, makeImage(4)}, {},
+                                                  COUNT, 5, false)
+                     ->await()) &&
+            fits(palette->extractColorsCached("lengths", image, COUNT, 5,
+                                              false)) &&
+            fits(palette->getCachedColors("lengths", COUNT, 5, false)) &&
+            fits(palette->extractColorsRefined(image, COUNT, 5, false)) &&
+            fits(palette->analyzeImage(image, IMAGE_SIZE, IMAGE_SIZE, 1,
+                                       COUNT, 5, false)
+                     .palette) &&
+            regionsFit,
+        "palettes hold no more colors than were asked for");
+}
+
+void testPaletteTree() {
+  // A noisy image and a flat one, which is recorded as its exact colors.
+  std::vector<std::vector<uint8_t>> images;
+  for (int seed = 0; seed < 3; seed++) {
+    auto image = makeImage(seed);
+    images.emplace_back(image->data(), image->data() + image->size());
+  }
+  std::vector<uint8_t> flat(IMAGE_SIZE * IMAGE_SIZE * 4, 255);
+  for (size_t i = 0; i < flat.size(); i += 4) {
+    flat[i] = static_cast<uint8_t>(i / 4 % 7 * 30);
+    flat[i + 1] = static_cast<uint8_t>(i / 4 % 3 * 60);
+  }
+  images.push_back(flat);
+
+  // Boxes that compare equal come out of quantize in no set order, so each
+  // color is matched to a box that sorts the same as quantize's box there.
+  auto matches = [](const std::vector<MMCQ::Color>& palette,
+                    const std::vector<MMCQ::VBox>& vboxes) {
+    if (palette.size() != vboxes.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < palette.size(); i++) {
+      bool found = false;
+      for (const auto& vbox : vboxes) {
+        found = found || (vbox.average.r == palette[i].r &&
+                          vbox.average.g == palette[i].g &&
+                          vbox.average.b == palette[i].b &&
+                          !MMCQ::compareByProduct(vbox, vboxes[i]) &&
+                          !MMCQ::compareByProduct(vboxes[i], vbox));
+      }
+      if (!found) {
+        return false;
+      }
+    }
+    return true;
+  };
+  bool same = true;
+  for (const auto& pixels : images) {
+    for (int maxColors : {4, 10, 24}) {
+      auto tree = SplitTree::quantize(pixels, maxColors, 5, false).serialize();
+      auto colorMap = MMCQ::quantize(pixels, maxColors, 5, false);
+      same = same && colorMap &&
+             matches(SplitTree::deserialize(tree.data(), tree.size())
+                         .makePalette(255),
+                     colorMap->getVBoxes());
+    }
+  }
+  check(same, "a palette tree at full size matches MMCQ::quantize");
+}
+
+void testDuplicateRequestIds() {
+  // One worker, held by the first request, so the second stays queued.
+  PaletteScheduler scheduler(1);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  auto noop = [] {};
+  scheduler.schedule(
+      1, 0, [released](const CancellationToken&) { released.wait(); }, noop);
+  scheduler.schedule(2, 0, [](const CancellationToken&) {}, noop);
+
+  // A duplicate id must not replace the running or queued request.
+  int rejected = 0;
+  for (uint64_t id : {1, 2}) {
+    try {
+      scheduler.schedule(id, 0, [](const CancellationToken&) {}, noop);
+    } catch (const std::runtime_error&) {
+      rejected++;
+    }
+  }
+  release.set_value();
+  check(rejected == 2, "a duplicate request id is rejected");
+}
+
+void testSharedCache(const std::string& cacheDirectory) {
+  // Two instances, as two JS runtimes would create, writing one directory.
+  auto first = std::make_shared<NitroPalette>();
+  auto second = std::make_shared<NitroPalette>();
+  first->configureCache(cacheDirectory);
+  second->configureCache(cacheDirectory);
+
+  std::vector<std::shared_ptr<ArrayBuffer>> images;
+  for (int i = 0; i < IMAGE_COUNT; i++) {
+    images.push_back(makeImage(i + IMAGE_COUNT));
+  }
+  constexpr int ROUNDS_PER_INSTANCE = 200;
+  constexpr int KEYS = 97;
+  auto makeCount = [](int round) { return 3 + round % 4; };
+  auto store = [&](NitroPalette& palette, int offset) {
+    for (int round = 0; round < ROUNDS_PER_INSTANCE; round++) {
+      palette.extractColorsCached("shared-" + std::to_string(round % KEYS),
+                                  images[(round + offset) % IMAGE_COUNT],
+                                  makeCount(round), 5, false);
+    }
+  };
+  std::thread a(store, std::ref(*first), 0);
+  std::thread b(store, std::ref(*second), 3);
+  a.join();
+  b.join();
+
+  // Every key written must be found by a third instance, holding the
+  // palette of one of the images that was stored under it.
+  auto reader = std::make_shared<NitroPalette>();
+  reader->configureCache(cacheDirectory);
+  bool readable = true;
+  for (int round = 0; round < ROUNDS_PER_INSTANCE; round++) {
+    int count = makeCount(round);
+    auto colors = reader->getCachedColors(
+        "shared-" + std::to_string(round % KEYS), count, 5, false);
+    bool known = false;
+    for (const auto& image : images) {
+      known = known || colors == reader->extractColors(image, count, 5, false);
+    }
+    readable = readable && known;
+  }
+  check(readable, "instances sharing a cache directory keep it consistent");
+}
+
+void testReaderAfterRehash(const std::string& cacheDirectory) {
+  std::string directory = cacheDirectory + "/rehash";
+  mkdir(directory.c_str(), 0755);
+  PaletteCache writer(directory);
+  PaletteCache reader(directory);
+
+  // Enough keys to rehash the writer's file more than once; the reader only
+  // looks up, so it must notice the new file on its own.
+  constexpr uint64_t KEYS = 4000;
+  const std::vector<MMCQ::Color> palette = {{1, 2, 3}, {4, 5, 6}};
+  std::vector<MMCQ::Color> found;
+  bool readable = true;
+  for (uint64_t key = 1; key <= KEYS; key++) {
+    writer.store(key, palette);
+    readable = readable && reader.find(key, found) && found.size() == 2;
+  }
+  check(readable, "a cache sees keys another cache wrote after a rehash");
+}
+
+}  // namespace
+
+int main() {
+  char directory[] = "/tmp/nitro-palette-testXXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  testConcurrentCalls(directory);
+  testDuplicateRequestIds();
+  testPaletteLengths(directory);
+  testPaletteTree();
+  testSharedCache(directory);
+  testReaderAfterRehash(directory);
+
+  if (failures > 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Just enough of NitroModules' ArrayBuffer to build NitroPalette outside a
+// React Native app: an owning buffer over a vector.
+namespace margelo::nitro {
+
+class ArrayBuffer {
+ public:
+  explicit ArrayBuffer(size_t size) : bytes(size) {}
+  virtual ~ArrayBuffer() = default;
+
+  uint8_t* data() { return bytes.data(); }
+  size_t size() const { return bytes.size(); }
+
+  static std::shared_ptr<ArrayBuffer> allocate(size_t size) {
+    return std::make_shared<ArrayBuffer>(size);
+  }
+
+ private:
+  std::vector<uint8_t> bytes;
+};
+
+}  // namespace margelo::nitro
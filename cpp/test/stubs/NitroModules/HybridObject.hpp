@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+namespace margelo::nitro {
+
+class HybridObject {
+ public:
+  explicit HybridObject(const char* name) : name(name) {}
+  virtual ~HybridObject() = default;
+
+  virtual size_t getExternalMemorySize() noexcept { return 0; }
+
+ protected:
+  virtual void loadHybridMethods() {}
+
+  const char* name;
+};
+
+}  // namespace margelo::nitro
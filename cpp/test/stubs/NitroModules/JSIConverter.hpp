@@ -0,0 +1,38 @@
+#pragma once
+
+// Declarations the generated JSI converters compile against. No test calls
+// into JSI, so nothing here is defined.
+namespace facebook::jsi {
+
+class Runtime;
+class Object;
+
+class Value {
+ public:
+  Value(const Object& object);
+  bool isObject() const;
+  Object asObject(Runtime& runtime) const;
+  Object getObject(Runtime& runtime) const;
+};
+
+class Object {
+ public:
+  explicit Object(Runtime& runtime);
+  Value getProperty(Runtime& runtime, const char* name) const;
+  void setProperty(Runtime& runtime, const char* name, const Value& value);
+};
+
+}  // namespace facebook::jsi
+
+namespace margelo::nitro {
+
+namespace jsi = facebook::jsi;
+
+template <typename T, typename Enable = void>
+struct JSIConverter {
+  static T fromJSI(jsi::Runtime& runtime, const jsi::Value& value);
+  static jsi::Value toJSI(jsi::Runtime& runtime, const T& value);
+  static bool canConvert(jsi::Runtime& runtime, const jsi::Value& value);
+};
+
+}  // namespace margelo::nitro
@@ -0,0 +1,80 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+// A promise that runs async work on a detached thread and can be waited on,
+// so tests can observe results without a JS runtime.
+namespace margelo::nitro {
+
+template <typename T>
+class Promise {
+ public:
+  using Value = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+  static std::shared_ptr<Promise<T>> create() {
+    return std::make_shared<Promise<T>>();
+  }
+
+  static std::shared_ptr<Promise<T>> async(std::function<T()>&& run) {
+    auto promise = create();
+    std::thread([promise, run = std::move(run)] {
+      try {
+        if constexpr (std::is_void_v<T>) {
+          run();
+          promise->resolve();
+        } else {
+          promise->resolve(run());
+        }
+      } catch (...) {
+        promise->reject(std::current_exception());
+      }
+    }).detach();
+    return promise;
+  }
+
+  template <typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+  void resolve(const U& value) {
+    settle(value, nullptr);
+  }
+
+  template <typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+  void resolve() {
+    settle(true, nullptr);
+  }
+
+  void reject(const std::exception_ptr& error) { settle(std::nullopt, error); }
+
+  // Blocks until settled; rethrows the rejection.
+  Value await() {
+    std::unique_lock<std::mutex> lock(mutex);
+    settled.wait(lock, [this] { return result || error; });
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return *result;
+  }
+
+ private:
+  void settle(std::optional<Value> value, std::exception_ptr failure) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (result || error) {
+      return;
+    }
+    result = std::move(value);
+    error = failure;
+    settled.notify_all();
+  }
+
+  std::mutex mutex;
+  std::condition_variable settled;
+  std::optional<Value> result;
+  std::exception_ptr error;
+};
+
+}  // namespace margelo::nitro
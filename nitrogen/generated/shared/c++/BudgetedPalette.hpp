@@ -0,0 +1,72 @@
+///
+/// BudgetedPalette.hpp
+/// This file was generated by nitrogen. DO NOT MODIFY THIS FILE.
+/// https://github.com/mrousavy/nitro
+/// Copyright © 2024 Marc Rousavy @ Margelo
+///
+
+#pragma once
+
+#if __has_include(<NitroModules/JSIConverter.hpp>)
+#include <NitroModules/JSIConverter.hpp>
+#else
+#error NitroModules cannot be found! Are you sure you installed NitroModules properly?
+#endif
+
+
+
+#include <string>
+#include <vector>
+
+namespace margelo::nitro::nitropalette {
+
+  /**
+   * A struct which can be represented as a JavaScript object (BudgetedPalette).
+   */
+  struct BudgetedPalette {
+  public:
+    std::vector<std::string> colors;
+    double pixelsUsed;
+    bool complete;
+
+  public:
+    explicit BudgetedPalette(std::vector<std::string> colors, double pixelsUsed, bool complete): colors(colors), pixelsUsed(pixelsUsed), complete(complete) {}
+  };
+
+} // namespace margelo::nitro::nitropalette
+
+namespace margelo::nitro {
+
+  using namespace margelo::nitro::nitropalette;
+
+  // C++ BudgetedPalette <> JS BudgetedPalette (object)
+  template <>
+  struct JSIConverter<BudgetedPalette> {
+    static inline BudgetedPalette fromJSI(jsi::Runtime& runtime, const jsi::Value& arg) {
+      jsi::Object obj = arg.asObject(runtime);
+      return BudgetedPalette(
+        JSIConverter<std::vector<std::string>>::fromJSI(runtime, obj.getProperty(runtime, "colors")),
+        JSIConverter<double>::fromJSI(runtime, obj.getProperty(runtime, "pixelsUsed")),
+        JSIConverter<bool>::fromJSI(runtime, obj.getProperty(runtime, "complete"))
+      );
+    }
+    static inline jsi::Value toJSI(jsi::Runtime& runtime, const BudgetedPalette& arg) {
+      jsi::Object obj(runtime);
+      obj.setProperty(runtime, "colors", JSIConverter<std::vector<std::string>>::toJSI(runtime, arg.colors));
+      obj.setProperty(runtime, "pixelsUsed", JSIConverter<double>::toJSI(runtime, arg.pixelsUsed));
+      obj.setProperty(runtime, "complete", JSIConverter<bool>::toJSI(runtime, arg.complete));
+      return obj;
+    }
+    static inline bool canConvert(jsi::Runtime& runtime, const jsi::Value& value) {
+      if (!value.isObject()) {
+        return false;
+      }
+      jsi::Object obj = value.getObject(runtime);
+      if (!JSIConverter<std::vector<std::string>>::canConvert(runtime, obj.getProperty(runtime, "colors"))) return false;
+      if (!JSIConverter<double>::canConvert(runtime, obj.getProperty(runtime, "pixelsUsed"))) return false;
+      if (!JSIConverter<bool>::canConvert(runtime, obj.getProperty(runtime, "complete"))) return false;
+      return true;
+    }
+  };
+
+} // namespace margelo::nitro
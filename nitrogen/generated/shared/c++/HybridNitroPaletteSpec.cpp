@@ -15,6 +15,34 @@ namespace margelo::nitro::nitropalette {
     // load custom methods/properties
     registerHybrids(this, [](Prototype& prototype) {
       prototype.registerHybridMethod("extractColors", &HybridNitroPaletteSpec::extractColors);
+      prototype.registerHybridMethod("trackFrame", &HybridNitroPaletteSpec::trackFrame);
+      prototype.registerHybridMethod("resetFrameTracking", &HybridNitroPaletteSpec::resetFrameTracking);
+      prototype.registerHybridMethod("extractColorsWithBudget", &HybridNitroPaletteSpec::extractColorsWithBudget);
+      prototype.registerHybridMethod("extractColorsFromEncoded", &HybridNitroPaletteSpec::extractColorsFromEncoded);
+      prototype.registerHybridMethod("extractColorsFromFile", &HybridNitroPaletteSpec::extractColorsFromFile);
+      prototype.registerHybridMethod("createRequestId", &HybridNitroPaletteSpec::createRequestId);
+      prototype.registerHybridMethod("extractColorsAsync", &HybridNitroPaletteSpec::extractColorsAsync);
+      prototype.registerHybridMethod("cancelExtraction", &HybridNitroPaletteSpec::cancelExtraction);
+      prototype.registerHybridMethod("setExtractionPriority", &HybridNitroPaletteSpec::setExtractionPriority);
+      prototype.registerHybridMethod("extractRegionColors", &HybridNitroPaletteSpec::extractRegionColors);
+      prototype.registerHybridMethod("indexPalettes", &HybridNitroPaletteSpec::indexPalettes);
+      prototype.registerHybridMethod("findSimilarPalettes", &HybridNitroPaletteSpec::findSimilarPalettes);
+      prototype.registerHybridMethod("serializePaletteIndex", &HybridNitroPaletteSpec::serializePaletteIndex);
+      prototype.registerHybridMethod("loadPaletteIndex", &HybridNitroPaletteSpec::loadPaletteIndex);
+      prototype.registerHybridMethod("clearPaletteIndex", &HybridNitroPaletteSpec::clearPaletteIndex);
+      prototype.registerHybridMethod("configureCache", &HybridNitroPaletteSpec::configureCache);
+      prototype.registerHybridMethod("getCachedColors", &HybridNitroPaletteSpec::getCachedColors);
+      prototype.registerHybridMethod("extractColorsCached", &HybridNitroPaletteSpec::extractColorsCached);
+      prototype.registerHybridMethod("ditherToPalette", &HybridNitroPaletteSpec::ditherToPalette);
+      prototype.registerHybridMethod("makeHistogram", &HybridNitroPaletteSpec::makeHistogram);
+      prototype.registerHybridMethod("extractColorsFromHistograms", &HybridNitroPaletteSpec::extractColorsFromHistograms);
+      prototype.registerHybridMethod("extractCollectionColors", &HybridNitroPaletteSpec::extractCollectionColors);
+      prototype.registerHybridMethod("extractSwatches", &HybridNitroPaletteSpec::extractSwatches);
+      prototype.registerHybridMethod("extractColorsRefined", &HybridNitroPaletteSpec::extractColorsRefined);
+      prototype.registerHybridMethod("makePaletteTree", &HybridNitroPaletteSpec::makePaletteTree);
+      prototype.registerHybridMethod("extractColorsFromPaletteTree", &HybridNitroPaletteSpec::extractColorsFromPaletteTree);
+      prototype.registerHybridMethod("analyzeImage", &HybridNitroPaletteSpec::analyzeImage);
+      prototype.registerHybridMethod("extractColorsFromYuv", &HybridNitroPaletteSpec::extractColorsFromYuv);
     });
   }
 
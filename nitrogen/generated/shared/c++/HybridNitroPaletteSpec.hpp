@@ -15,10 +15,21 @@
 
 // Forward declaration of `ArrayBuffer` to properly resolve imports.
 namespace NitroModules { class ArrayBuffer; }
+// Forward declaration of `BudgetedPalette` to properly resolve imports.
+namespace margelo::nitro::nitropalette { struct BudgetedPalette; }
+// Forward declaration of `Swatch` to properly resolve imports.
+namespace margelo::nitro::nitropalette { struct Swatch; }
+// Forward declaration of `ImageAnalysis` to properly resolve imports.
+namespace margelo::nitro::nitropalette { struct ImageAnalysis; }
 
 #include <vector>
 #include <string>
 #include <NitroModules/ArrayBuffer.hpp>
+#include <NitroModules/Promise.hpp>
+#include "BudgetedPalette.hpp"
+#include <functional>
+#include "Swatch.hpp"
+#include "ImageAnalysis.hpp"
 
 namespace margelo::nitro::nitropalette {
 
@@ -52,6 +63,34 @@ namespace margelo::nitro::nitropalette {
     public:
       // Methods
       virtual std::vector<std::string> extractColors(const std::shared_ptr<ArrayBuffer>& source, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> trackFrame(const std::shared_ptr<ArrayBuffer>& source, double colorCount, bool ignoreWhite) = 0;
+      virtual void resetFrameTracking() = 0;
+      virtual std::shared_ptr<Promise<BudgetedPalette>> extractColorsWithBudget(const std::shared_ptr<ArrayBuffer>& source, double colorCount, bool ignoreWhite, double budgetMs, const std::function<void(const std::vector<std::string>& /* colors */)>& onEarlyResult) = 0;
+      virtual std::shared_ptr<Promise<std::vector<std::string>>> extractColorsFromEncoded(const std::shared_ptr<ArrayBuffer>& source, double colorCount, double quality, bool ignoreWhite, double maxDimension) = 0;
+      virtual std::shared_ptr<Promise<std::vector<std::string>>> extractColorsFromFile(const std::string& path, double colorCount, double quality, bool ignoreWhite, double maxDimension) = 0;
+      virtual double createRequestId() = 0;
+      virtual std::shared_ptr<Promise<std::vector<std::string>>> extractColorsAsync(const std::shared_ptr<ArrayBuffer>& source, double colorCount, double quality, bool ignoreWhite, double requestId, double priority) = 0;
+      virtual void cancelExtraction(double requestId) = 0;
+      virtual void setExtractionPriority(double requestId, double priority) = 0;
+      virtual std::vector<std::vector<std::string>> extractRegionColors(const std::shared_ptr<ArrayBuffer>& source, double width, double height, double columns, double rows, double edgeFraction, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::shared_ptr<Promise<void>> indexPalettes(const std::vector<std::string>& ids, const std::vector<std::shared_ptr<ArrayBuffer>>& sources, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> findSimilarPalettes(const std::vector<double>& colors, double count) = 0;
+      virtual std::shared_ptr<ArrayBuffer> serializePaletteIndex() = 0;
+      virtual void loadPaletteIndex(const std::shared_ptr<ArrayBuffer>& data) = 0;
+      virtual void clearPaletteIndex() = 0;
+      virtual void configureCache(const std::string& directory) = 0;
+      virtual std::vector<std::string> getCachedColors(const std::string& key, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> extractColorsCached(const std::string& key, const std::shared_ptr<ArrayBuffer>& source, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> ditherToPalette(const std::shared_ptr<ArrayBuffer>& source, double width, double height, double colorCount, double quality, bool ignoreWhite, const std::shared_ptr<ArrayBuffer>& output) = 0;
+      virtual std::shared_ptr<ArrayBuffer> makeHistogram(const std::shared_ptr<ArrayBuffer>& source, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> extractColorsFromHistograms(const std::vector<std::shared_ptr<ArrayBuffer>>& histograms, const std::vector<double>& weights, double colorCount) = 0;
+      virtual std::shared_ptr<Promise<std::vector<std::string>>> extractCollectionColors(const std::vector<std::shared_ptr<ArrayBuffer>>& sources, const std::vector<double>& weights, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<Swatch> extractSwatches(const std::shared_ptr<ArrayBuffer>& source, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> extractColorsRefined(const std::shared_ptr<ArrayBuffer>& source, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::shared_ptr<ArrayBuffer> makePaletteTree(const std::shared_ptr<ArrayBuffer>& source, double maxColors, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> extractColorsFromPaletteTree(const std::shared_ptr<ArrayBuffer>& tree, double colorCount) = 0;
+      virtual ImageAnalysis analyzeImage(const std::shared_ptr<ArrayBuffer>& source, double width, double height, double outputs, double colorCount, double quality, bool ignoreWhite) = 0;
+      virtual std::vector<std::string> extractColorsFromYuv(const std::shared_ptr<ArrayBuffer>& y, const std::shared_ptr<ArrayBuffer>& u, const std::shared_ptr<ArrayBuffer>& v, double width, double height, double yRowStride, double yPixelStride, double uRowStride, double uPixelStride, double uOffset, double vRowStride, double vPixelStride, double vOffset, bool bt709, bool fullRange, double colorCount, double quality, bool ignoreWhite) = 0;
 
     protected:
       // Hybrid Setup
@@ -0,0 +1,76 @@
+///
+/// ImageAnalysis.hpp
+/// This file was generated by nitrogen. DO NOT MODIFY THIS FILE.
+/// https://github.com/mrousavy/nitro
+/// Copyright © 2024 Marc Rousavy @ Margelo
+///
+
+#pragma once
+
+#if __has_include(<NitroModules/JSIConverter.hpp>)
+#include <NitroModules/JSIConverter.hpp>
+#else
+#error NitroModules cannot be found! Are you sure you installed NitroModules properly?
+#endif
+
+
+
+#include <string>
+#include <vector>
+
+namespace margelo::nitro::nitropalette {
+
+  /**
+   * A struct which can be represented as a JavaScript object (ImageAnalysis).
+   */
+  struct ImageAnalysis {
+  public:
+    std::vector<std::string> palette;
+    std::string averageColor;
+    std::vector<double> luminanceHistogram;
+    std::string placeholder;
+
+  public:
+    explicit ImageAnalysis(std::vector<std::string> palette, std::string averageColor, std::vector<double> luminanceHistogram, std::string placeholder): palette(palette), averageColor(averageColor), luminanceHistogram(luminanceHistogram), placeholder(placeholder) {}
+  };
+
+} // namespace margelo::nitro::nitropalette
+
+namespace margelo::nitro {
+
+  using namespace margelo::nitro::nitropalette;
+
+  // C++ ImageAnalysis <> JS ImageAnalysis (object)
+  template <>
+  struct JSIConverter<ImageAnalysis> {
+    static inline ImageAnalysis fromJSI(jsi::Runtime& runtime, const jsi::Value& arg) {
+      jsi::Object obj = arg.asObject(runtime);
+      return ImageAnalysis(
+        JSIConverter<std::vector<std::string>>::fromJSI(runtime, obj.getProperty(runtime, "palette")),
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "averageColor")),
+        JSIConverter<std::vector<double>>::fromJSI(runtime, obj.getProperty(runtime, "luminanceHistogram")),
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "placeholder"))
+      );
+    }
+    static inline jsi::Value toJSI(jsi::Runtime& runtime, const ImageAnalysis& arg) {
+      jsi::Object obj(runtime);
+      obj.setProperty(runtime, "palette", JSIConverter<std::vector<std::string>>::toJSI(runtime, arg.palette));
+      obj.setProperty(runtime, "averageColor", JSIConverter<std::string>::toJSI(runtime, arg.averageColor));
+      obj.setProperty(runtime, "luminanceHistogram", JSIConverter<std::vector<double>>::toJSI(runtime, arg.luminanceHistogram));
+      obj.setProperty(runtime, "placeholder", JSIConverter<std::string>::toJSI(runtime, arg.placeholder));
+      return obj;
+    }
+    static inline bool canConvert(jsi::Runtime& runtime, const jsi::Value& value) {
+      if (!value.isObject()) {
+        return false;
+      }
+      jsi::Object obj = value.getObject(runtime);
+      if (!JSIConverter<std::vector<std::string>>::canConvert(runtime, obj.getProperty(runtime, "palette"))) return false;
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "averageColor"))) return false;
+      if (!JSIConverter<std::vector<double>>::canConvert(runtime, obj.getProperty(runtime, "luminanceHistogram"))) return false;
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "placeholder"))) return false;
+      return true;
+    }
+  };
+
+} // namespace margelo::nitro
@@ -0,0 +1,79 @@
+///
+/// Swatch.hpp
+/// This file was generated by nitrogen. DO NOT MODIFY THIS FILE.
+/// https://github.com/mrousavy/nitro
+/// Copyright © 2024 Marc Rousavy @ Margelo
+///
+
+#pragma once
+
+#if __has_include(<NitroModules/JSIConverter.hpp>)
+#include <NitroModules/JSIConverter.hpp>
+#else
+#error NitroModules cannot be found! Are you sure you installed NitroModules properly?
+#endif
+
+
+
+#include <string>
+
+namespace margelo::nitro::nitropalette {
+
+  /**
+   * A struct which can be represented as a JavaScript object (Swatch).
+   */
+  struct Swatch {
+  public:
+    std::string role;
+    std::string color;
+    double population;
+    std::string titleTextColor;
+    std::string bodyTextColor;
+
+  public:
+    explicit Swatch(std::string role, std::string color, double population, std::string titleTextColor, std::string bodyTextColor): role(role), color(color), population(population), titleTextColor(titleTextColor), bodyTextColor(bodyTextColor) {}
+  };
+
+} // namespace margelo::nitro::nitropalette
+
+namespace margelo::nitro {
+
+  using namespace margelo::nitro::nitropalette;
+
+  // C++ Swatch <> JS Swatch (object)
+  template <>
+  struct JSIConverter<Swatch> {
+    static inline Swatch fromJSI(jsi::Runtime& runtime, const jsi::Value& arg) {
+      jsi::Object obj = arg.asObject(runtime);
+      return Swatch(
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "role")),
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "color")),
+        JSIConverter<double>::fromJSI(runtime, obj.getProperty(runtime, "population")),
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "titleTextColor")),
+        JSIConverter<std::string>::fromJSI(runtime, obj.getProperty(runtime, "bodyTextColor"))
+      );
+    }
+    static inline jsi::Value toJSI(jsi::Runtime& runtime, const Swatch& arg) {
+      jsi::Object obj(runtime);
+      obj.setProperty(runtime, "role", JSIConverter<std::string>::toJSI(runtime, arg.role));
+      obj.setProperty(runtime, "color", JSIConverter<std::string>::toJSI(runtime, arg.color));
+      obj.setProperty(runtime, "population", JSIConverter<double>::toJSI(runtime, arg.population));
+      obj.setProperty(runtime, "titleTextColor", JSIConverter<std::string>::toJSI(runtime, arg.titleTextColor));
+      obj.setProperty(runtime, "bodyTextColor", JSIConverter<std::string>::toJSI(runtime, arg.bodyTextColor));
+      return obj;
+    }
+    static inline bool canConvert(jsi::Runtime& runtime, const jsi::Value& value) {
+      if (!value.isObject()) {
+        return false;
+      }
+      jsi::Object obj = value.getObject(runtime);
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "role"))) return false;
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "color"))) return false;
+      if (!JSIConverter<double>::canConvert(runtime, obj.getProperty(runtime, "population"))) return false;
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "titleTextColor"))) return false;
+      if (!JSIConverter<std::string>::canConvert(runtime, obj.getProperty(runtime, "bodyTextColor"))) return false;
+      return true;
+    }
+  };
+
+} // namespace margelo::nitro
@@ -1,4 +1,37 @@
 declare module 'react-native-nitro-palette' {
+  export interface BudgetedPalette {
+    /** rgb color strings */
+    colors: string[];
+    /** Number of pixels that contributed to the palette */
+    pixelsUsed: number;
+    /** Whether every pixel was sampled within the budget */
+    complete: boolean;
+  }
+
+  export interface Swatch {
+    /** 'vibrant', 'lightVibrant', 'darkVibrant', 'muted', 'lightMuted', 'darkMuted' or 'dominant' */
+    role: string;
+    /** rgb color string */
+    color: string;
+    /** Number of sampled pixels the color stands for */
+    population: number;
+    /** rgba color string for titles drawn on the swatch */
+    titleTextColor: string;
+    /** rgba color string for body text drawn on the swatch */
+    bodyTextColor: string;
+  }
+
+  export interface ImageAnalysis {
+    /** Array of rgb color strings, empty unless requested */
+    palette: string[];
+    /** rgb color string of the mean opaque color, empty unless requested */
+    averageColor: string;
+    /** Fraction of opaque pixels in each of 32 luminance bins, darkest first, empty unless requested */
+    luminanceHistogram: number[];
+    /** BlurHash string with 4x3 components, empty unless requested */
+    placeholder: string;
+  }
+
   /**
    * Extracts a color palette from an image.
    * @param source - The image source URI
@@ -13,4 +46,422 @@ declare module 'react-native-nitro-palette' {
     quality?: number,
     ignoreWhite?: boolean
   ): Promise<string[]>;
+
+  export interface PaletteRequestOptions {
+    /** The number of colors to extract (default: 5) */
+    colorCount?: number;
+    /** The quality of the color extraction (1-10, default: 10) */
+    quality?: number;
+    /** Whether to ignore white colors (default: true) */
+    ignoreWhite?: boolean;
+    /** Requests with a higher priority start first (default: 0) */
+    priority?: number;
+    /** Cancels the request when aborted, e.g. when the requesting view unmounts */
+    signal?: AbortSignal;
+  }
+
+  /**
+   * Extracts a color palette from RGBA pixels on a background thread.
+   * Queued requests run by priority and can be cancelled through an AbortSignal.
+   * @param pixels - RGBA pixels of the image
+   * @param options - Extraction, priority and cancellation options
+   * @returns Promise resolving to an array of rgb color strings, rejected if cancelled
+   */
+  export function getPaletteFromPixelsAsync(
+    pixels: ArrayBuffer,
+    options?: PaletteRequestOptions
+  ): Promise<string[]>;
+
+  /**
+   * Extracts a color palette from a local image file, decoding it natively at a reduced size.
+   * @param path - Path or file:// URI of a JPEG, PNG or WebP image
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @param maxDimension - Longest side of the decoded image in pixels (default: 256)
+   * @returns Promise resolving to an array of rgb color strings, rejected on
+   * Android below 11 (API 30), which lacks the native decoder; decode with
+   * Skia there and use getPaletteFromPixelsAsync instead
+   */
+  export function getPaletteFromFileAsync(
+    path: string,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean,
+    maxDimension?: number
+  ): Promise<string[]>;
+
+  /**
+   * Extracts a color palette from encoded image bytes, decoding them natively at a reduced size.
+   * @param data - Contents of a JPEG, PNG or WebP file
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @param maxDimension - Longest side of the decoded image in pixels (default: 256)
+   * @returns Promise resolving to an array of rgb color strings, rejected on
+   * Android below 11 (API 30), which lacks the native decoder; decode with
+   * Skia there and use getPaletteFromPixelsAsync instead
+   */
+  export function getPaletteFromEncodedAsync(
+    data: ArrayBuffer,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean,
+    maxDimension?: number
+  ): Promise<string[]>;
+
+  /**
+   * Updates the palette of a frame sequence (camera preview, video) with a new frame.
+   * Consecutive calls share state, so the palette stays stable between similar frames.
+   * @param pixels - RGBA pixels of the frame
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Array of rgb color strings
+   */
+  export function trackPaletteFrame(
+    pixels: ArrayBuffer,
+    colorCount?: number,
+    ignoreWhite?: boolean
+  ): string[];
+
+  /**
+   * Discards the state accumulated by trackPaletteFrame.
+   */
+  export function resetPaletteTracking(): void;
+
+  /**
+   * Extracts a color palette within a time budget, sampling pixels coarse to fine.
+   * @param pixels - RGBA pixels of the image
+   * @param budgetMs - Time budget in milliseconds
+   * @param onEarlyResult - Called once with a preliminary palette as soon as the sampled colors stop changing
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Promise resolving to the palette and how many pixels it was computed from
+   */
+  export function getPaletteWithBudgetAsync(
+    pixels: ArrayBuffer,
+    budgetMs: number,
+    onEarlyResult?: (colors: string[]) => void,
+    colorCount?: number,
+    ignoreWhite?: boolean
+  ): Promise<BudgetedPalette>;
+
+  export interface RegionPaletteOptions {
+    /** Number of tile columns (1-16, default: 1) */
+    columns?: number;
+    /** Number of tile rows (1-16, default: 1) */
+    rows?: number;
+    /** Height of the top and bottom edge bands as a fraction of the image height (0-0.5, default: 0 for no bands) */
+    edgeFraction?: number;
+    /** The number of colors to extract per region (default: 5) */
+    colorCount?: number;
+    /** The quality of the color extraction (1-10, default: 10) */
+    quality?: number;
+    /** Whether to ignore white colors (default: true) */
+    ignoreWhite?: boolean;
+  }
+
+  export interface RegionPalettes {
+    /** Palette of every grid tile, row by row from the top left */
+    tiles: string[][];
+    /** Palette of the top edge band, empty without edge bands */
+    top: string[];
+    /** Palette of the bottom edge band, empty without edge bands */
+    bottom: string[];
+  }
+
+  /**
+   * Extracts separate palettes for a grid of tiles and the top and bottom edges in a single pass over the pixels.
+   * @param pixels - RGBA pixels of the image
+   * @param width - Width of the image in pixels
+   * @param height - Height of the image in pixels
+   * @param options - Grid, edge bands and extraction settings
+   * @returns Palettes of every region as arrays of rgb color strings
+   */
+  export function getRegionPalettes(
+    pixels: ArrayBuffer,
+    width: number,
+    height: number,
+    options?: RegionPaletteOptions
+  ): RegionPalettes;
+
+  /**
+   * Adds palette signatures of images to the in-memory similarity index.
+   * Indexing an id again replaces its signature.
+   * @param ids - Identifiers returned by findSimilarPalettes, e.g. image URIs
+   * @param pixels - RGBA pixels of each image, in the same order as ids
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Promise resolving once the images are searchable
+   */
+  export function indexPalettesAsync(
+    ids: string[],
+    pixels: ArrayBuffer[],
+    quality?: number,
+    ignoreWhite?: boolean
+  ): Promise<void>;
+
+  /**
+   * Finds the indexed images whose palettes are closest to the given colors.
+   * @param colors - Colors as '#rrggbb' or 'rgb(r, g, b)' strings
+   * @param count - Maximum number of images to return (default: 10)
+   * @returns Ids of the closest images, nearest first
+   */
+  export function findSimilarPalettes(
+    colors: string[],
+    count?: number
+  ): string[];
+
+  /**
+   * Writes the similarity index to a buffer that loadPaletteIndex accepts.
+   */
+  export function serializePaletteIndex(): ArrayBuffer;
+
+  /**
+   * Replaces the similarity index with one written by serializePaletteIndex.
+   * @param data - Serialized index
+   */
+  export function loadPaletteIndex(data: ArrayBuffer): void;
+
+  /**
+   * Removes every image from the similarity index.
+   */
+  export function clearPaletteIndex(): void;
+
+  /**
+   * Enables the on-disk palette cache, which keeps palettes across app launches.
+   * @param directory - Path or file:// URI of a writable directory, e.g. the app's cache directory; an empty string disables the cache
+   */
+  export function configurePaletteCache(directory: string): void;
+
+  /**
+   * Looks up a cached palette without touching any pixels.
+   * @param key - Key the palette was cached under by getPaletteCached
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Array of rgb color strings, empty when nothing is cached
+   */
+  export function getCachedPalette(
+    key: string,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): string[];
+
+  /**
+   * Extracts a color palette from RGBA pixels, serving and filling the palette cache.
+   * @param pixels - RGBA pixels of the image
+   * @param key - Identifies the image content, e.g. a URI with its modification time; when empty the pixels are hashed
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Array of rgb color strings
+   */
+  export function getPaletteCached(
+    pixels: ArrayBuffer,
+    key?: string,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): string[];
+
+  /**
+   * Renders an image with Floyd–Steinberg dithering to its own extracted palette, e.g. for e-ink displays or GIF export.
+   * @param pixels - RGBA pixels of the image
+   * @param width - Width of the image in pixels
+   * @param height - Height of the image in pixels
+   * @param output - Buffer of the same size as pixels that receives the dithered RGBA pixels
+   * @param colorCount - The number of colors to extract (default: 16)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors when extracting the palette (default: false)
+   * @returns The palette the image was dithered to, as rgb color strings
+   */
+  export function ditherToPalette(
+    pixels: ArrayBuffer,
+    width: number,
+    height: number,
+    output: ArrayBuffer,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): string[];
+
+  /**
+   * Samples an image into a compact color histogram that can be combined with others later.
+   * @param pixels - RGBA pixels of the image
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Serialized histogram
+   */
+  export function makePaletteHistogram(
+    pixels: ArrayBuffer,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): ArrayBuffer;
+
+  /**
+   * Extracts one color palette from histograms made by makePaletteHistogram.
+   * @param histograms - Serialized histograms
+   * @param weights - Weight of each histogram's pixel counts (default: 1 for every histogram)
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @returns Array of rgb color strings
+   */
+  export function getPaletteFromHistograms(
+    histograms: ArrayBuffer[],
+    weights?: number[],
+    colorCount?: number
+  ): string[];
+
+  /**
+   * Extracts one color palette for a set of images, such as an album, sampling the images in parallel.
+   * @param images - RGBA pixels of each image
+   * @param weights - Weight of each image's pixel counts (default: 1 for every image)
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Promise resolving to an array of rgb color strings
+   */
+  export function getCollectionPaletteAsync(
+    images: ArrayBuffer[],
+    weights?: number[],
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): Promise<string[]>;
+
+  /**
+   * Classifies the colors of an image into role-based swatches with readable text colors, like Android's Palette.
+   * @param pixels - RGBA pixels of the image
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: false)
+   * @returns Swatches for the roles the image has colors for, plus the dominant swatch
+   */
+  export function getSwatches(
+    pixels: ArrayBuffer,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): Swatch[];
+
+  /**
+   * Extracts a palette with cuts made at 7 bits per channel inside the color clusters of the image, for photos whose colors crowd into a few regions.
+   * @param pixels - RGBA pixels of the image
+   * @param colorCount - Number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Array of colors in RGB format
+   */
+  export function getPaletteRefined(
+    pixels: ArrayBuffer,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): string[];
+
+  /**
+   * Records every cut of one palette extraction, so palettes of any size up to maxColors can be read back instantly with getPaletteFromTree.
+   * The full-size palette is the one getPaletteFromPixelsAsync returns for maxColors. A smaller palette holds the boxes left after fewer cuts, which can differ from extracting that many colors directly; for an image with at most maxColors colors, it holds the most populated colors and the average of the rest.
+   * @param pixels - RGBA pixels of the image
+   * @param maxColors - Largest palette that will be read from the tree (1-255, default: 20)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns The serialized tree
+   */
+  export function makePaletteTree(
+    pixels: ArrayBuffer,
+    maxColors?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): ArrayBuffer;
+
+  /**
+   * Reads a palette from a tree made by makePaletteTree without quantizing again, for sliders that change the palette size.
+   * @param tree - Serialized tree
+   * @param colorCount - The number of colors to read (default: 5)
+   * @returns Array of rgb color strings, in the order getPaletteFromPixelsAsync uses
+   */
+  export function getPaletteFromTree(
+    tree: ArrayBuffer,
+    colorCount?: number
+  ): string[];
+
+  export interface ImageAnalysisOptions {
+    /** Whether to extract the palette (default: true) */
+    palette?: boolean;
+    /** Whether to compute the average color (default: false) */
+    averageColor?: boolean;
+    /** Whether to compute the luminance histogram (default: false) */
+    luminanceHistogram?: boolean;
+    /** Whether to compute the BlurHash placeholder (default: false) */
+    placeholder?: boolean;
+    /** The number of colors to extract (default: 5) */
+    colorCount?: number;
+    /** The quality of the analysis (1-10, default: 10) */
+    quality?: number;
+    /** Whether to ignore white colors in the palette (default: true) */
+    ignoreWhite?: boolean;
+  }
+
+  /**
+   * Computes the requested summaries of an image in a single pass over its pixels.
+   * @param pixels - RGBA pixels of the image
+   * @param width - Width of the image in pixels
+   * @param height - Height of the image in pixels
+   * @param options - Outputs to compute and extraction settings
+   * @returns The requested outputs; the others are empty
+   */
+  export function analyzeImage(
+    pixels: ArrayBuffer,
+    width: number,
+    height: number,
+    options?: ImageAnalysisOptions
+  ): ImageAnalysis;
+
+  export interface YuvPlane {
+    /** Bytes of the plane, such as an Android Image.Plane buffer or an iOS CVPixelBuffer plane */
+    data: ArrayBuffer;
+    /** Bytes per row (default: the plane width times pixelStride) */
+    rowStride?: number;
+    /** Bytes between horizontally adjacent samples, 2 for interleaved chroma (default: 1) */
+    pixelStride?: number;
+    /** Byte offset of the first sample, 1 for the second channel of interleaved chroma (default: 0) */
+    offset?: number;
+  }
+
+  /**
+   * A YUV 4:2:0 frame as three planes, each with its own strides. I420 passes three separate planes.
+   * NV12 passes the interleaved chroma buffer as both u and v with a pixelStride of 2 and v at offset 1;
+   * NV21 swaps the offsets. Android YUV_420_888 planes map over one to one.
+   */
+  export interface YuvFrame {
+    /** Width of the frame in pixels */
+    width: number;
+    /** Height of the frame in pixels */
+    height: number;
+    /** Luma plane */
+    y: YuvPlane;
+    /** Cb plane */
+    u: YuvPlane;
+    /** Cr plane */
+    v: YuvPlane;
+    /** Color matrix of the frame (default: 'bt601') */
+    matrix?: 'bt601' | 'bt709';
+    /** Whether luma spans 0-255 instead of the video range 16-235 (default: false) */
+    fullRange?: boolean;
+  }
+
+  /**
+   * Extracts a color palette straight from a YUV 4:2:0 camera frame, without converting it to RGBA.
+   * @param frame - The frame planes and their layout
+   * @param colorCount - The number of colors to extract (default: 5)
+   * @param quality - The quality of the color extraction (1-10, default: 10)
+   * @param ignoreWhite - Whether to ignore white colors (default: true)
+   * @returns Array of rgb color strings
+   */
+  export function getPaletteFromYuv(
+    frame: YuvFrame,
+    colorCount?: number,
+    quality?: number,
+    ignoreWhite?: boolean
+  ): string[];
 }
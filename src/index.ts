@@ -1,5 +1,10 @@
 import { AlphaType, ColorType, Skia, loadData } from '@shopify/react-native-skia';
 import { NitroPalette } from './specs';
+import type {
+  BudgetedPalette,
+  ImageAnalysis,
+  Swatch,
+} from './specs/NitroPalette.nitro';
 
 const imgFactory = Skia.Image.MakeImageFromEncoded.bind(Skia.Image);
 
@@ -29,3 +34,418 @@ export const getPaletteAsync = async (
     throw new Error(error instanceof Error ? error.message : String(error));
   }
 }
+
+export const getPaletteFromFileAsync = (
+  path: string,
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true,
+  maxDimension: number = 256
+): Promise<string[]> => {
+  const filePath = path.startsWith('file://')
+    ? decodeURI(path.slice('file://'.length))
+    : path;
+  return NitroPalette.extractColorsFromFile(
+    filePath,
+    colorCount,
+    quality,
+    ignoreWhite,
+    maxDimension
+  );
+}
+
+export const getPaletteFromEncodedAsync = (
+  data: ArrayBuffer,
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true,
+  maxDimension: number = 256
+): Promise<string[]> => {
+  return NitroPalette.extractColorsFromEncoded(
+    data,
+    colorCount,
+    quality,
+    ignoreWhite,
+    maxDimension
+  );
+}
+
+export interface PaletteRequestOptions {
+  colorCount?: number;
+  quality?: number;
+  ignoreWhite?: boolean;
+  priority?: number;
+  signal?: AbortSignal;
+}
+
+export const getPaletteFromPixelsAsync = (
+  pixels: ArrayBuffer,
+  options: PaletteRequestOptions = {}
+): Promise<string[]> => {
+  const {
+    colorCount = 5,
+    quality = 10,
+    ignoreWhite = true,
+    priority = 0,
+    signal,
+  } = options;
+  if (signal?.aborted) {
+    return Promise.reject(new Error('Palette request was cancelled'));
+  }
+
+  // Native ids stay unique when several runtimes share the module.
+  const requestId = NitroPalette.createRequestId();
+  const onAbort = () => NitroPalette.cancelExtraction(requestId);
+  signal?.addEventListener('abort', onAbort);
+  return NitroPalette.extractColorsAsync(
+    pixels,
+    colorCount,
+    quality,
+    ignoreWhite,
+    requestId,
+    priority
+  ).finally(() => signal?.removeEventListener('abort', onAbort));
+}
+
+export const trackPaletteFrame = (
+  pixels: ArrayBuffer,
+  colorCount: number = 5,
+  ignoreWhite: boolean = true
+): string[] => {
+  return NitroPalette.trackFrame(pixels, colorCount, ignoreWhite);
+}
+
+export const resetPaletteTracking = (): void => {
+  NitroPalette.resetFrameTracking();
+}
+
+export const getPaletteWithBudgetAsync = (
+  pixels: ArrayBuffer,
+  budgetMs: number,
+  onEarlyResult: (colors: string[]) => void = () => {},
+  colorCount: number = 5,
+  ignoreWhite: boolean = true
+): Promise<BudgetedPalette> => {
+  return NitroPalette.extractColorsWithBudget(
+    pixels,
+    colorCount,
+    ignoreWhite,
+    budgetMs,
+    onEarlyResult
+  );
+}
+
+export interface RegionPaletteOptions {
+  columns?: number;
+  rows?: number;
+  edgeFraction?: number;
+  colorCount?: number;
+  quality?: number;
+  ignoreWhite?: boolean;
+}
+
+export interface RegionPalettes {
+  tiles: string[][];
+  top: string[];
+  bottom: string[];
+}
+
+export const getRegionPalettes = (
+  pixels: ArrayBuffer,
+  width: number,
+  height: number,
+  options: RegionPaletteOptions = {}
+): RegionPalettes => {
+  const {
+    columns = 1,
+    rows = 1,
+    edgeFraction = 0,
+    colorCount = 5,
+    quality = 10,
+    ignoreWhite = true,
+  } = options;
+  const palettes = NitroPalette.extractRegionColors(
+    pixels,
+    width,
+    height,
+    columns,
+    rows,
+    edgeFraction,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+  const hasEdges = edgeFraction > 0 && palettes.length > 0;
+  const tileCount = hasEdges ? palettes.length - 2 : palettes.length;
+  return {
+    tiles: palettes.slice(0, tileCount),
+    top: hasEdges ? palettes[tileCount] ?? [] : [],
+    bottom: hasEdges ? palettes[tileCount + 1] ?? [] : [],
+  };
+}
+
+export const indexPalettesAsync = (
+  ids: string[],
+  pixels: ArrayBuffer[],
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): Promise<void> => {
+  return NitroPalette.indexPalettes(ids, pixels, quality, ignoreWhite);
+}
+
+const parseColor = (color: string): number => {
+  const hex = /^#([0-9a-f]{6})$/i.exec(color);
+  if (hex) {
+    return parseInt(hex[1]!, 16);
+  }
+  const rgb = /^rgb\(\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)\s*\)$/i.exec(color);
+  if (rgb) {
+    return (Number(rgb[1]) << 16) | (Number(rgb[2]) << 8) | Number(rgb[3]);
+  }
+  throw new Error(`Invalid color: ${color}`);
+}
+
+export const findSimilarPalettes = (
+  colors: string[],
+  count: number = 10
+): string[] => {
+  return NitroPalette.findSimilarPalettes(colors.map(parseColor), count);
+}
+
+export const serializePaletteIndex = (): ArrayBuffer => {
+  return NitroPalette.serializePaletteIndex();
+}
+
+export const loadPaletteIndex = (data: ArrayBuffer): void => {
+  NitroPalette.loadPaletteIndex(data);
+}
+
+export const clearPaletteIndex = (): void => {
+  NitroPalette.clearPaletteIndex();
+}
+
+export const configurePaletteCache = (directory: string): void => {
+  const directoryPath = directory.startsWith('file://')
+    ? decodeURI(directory.slice('file://'.length))
+    : directory;
+  NitroPalette.configureCache(directoryPath);
+}
+
+export const getCachedPalette = (
+  key: string,
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): string[] => {
+  return NitroPalette.getCachedColors(key, colorCount, quality, ignoreWhite);
+}
+
+export const getPaletteCached = (
+  pixels: ArrayBuffer,
+  key: string = '',
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): string[] => {
+  return NitroPalette.extractColorsCached(
+    key,
+    pixels,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+}
+
+export const ditherToPalette = (
+  pixels: ArrayBuffer,
+  width: number,
+  height: number,
+  output: ArrayBuffer,
+  colorCount: number = 16,
+  quality: number = 10,
+  ignoreWhite: boolean = false
+): string[] => {
+  return NitroPalette.ditherToPalette(
+    pixels,
+    width,
+    height,
+    colorCount,
+    quality,
+    ignoreWhite,
+    output
+  );
+}
+
+export const makePaletteHistogram = (
+  pixels: ArrayBuffer,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): ArrayBuffer => {
+  return NitroPalette.makeHistogram(pixels, quality, ignoreWhite);
+}
+
+export const getPaletteFromHistograms = (
+  histograms: ArrayBuffer[],
+  weights: number[] = [],
+  colorCount: number = 5
+): string[] => {
+  return NitroPalette.extractColorsFromHistograms(
+    histograms,
+    weights,
+    colorCount
+  );
+}
+
+export const getCollectionPaletteAsync = (
+  images: ArrayBuffer[],
+  weights: number[] = [],
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): Promise<string[]> => {
+  return NitroPalette.extractCollectionColors(
+    images,
+    weights,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+}
+
+export const getSwatches = (
+  pixels: ArrayBuffer,
+  quality: number = 10,
+  ignoreWhite: boolean = false
+): Swatch[] => {
+  return NitroPalette.extractSwatches(pixels, quality, ignoreWhite);
+}
+
+export const getPaletteRefined = (
+  pixels: ArrayBuffer,
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): string[] => {
+  const palette = NitroPalette.extractColorsRefined(
+    pixels,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+  return palette.slice(0, colorCount);
+}
+
+export const makePaletteTree = (
+  pixels: ArrayBuffer,
+  maxColors: number = 20,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): ArrayBuffer => {
+  return NitroPalette.makePaletteTree(pixels, maxColors, quality, ignoreWhite);
+}
+
+export const getPaletteFromTree = (
+  tree: ArrayBuffer,
+  colorCount: number = 5
+): string[] => {
+  return NitroPalette.extractColorsFromPaletteTree(tree, colorCount);
+}
+
+export interface ImageAnalysisOptions {
+  palette?: boolean;
+  averageColor?: boolean;
+  luminanceHistogram?: boolean;
+  placeholder?: boolean;
+  colorCount?: number;
+  quality?: number;
+  ignoreWhite?: boolean;
+}
+
+// Output flags of the native analysis; keep in sync with ImageAnalyzer.
+const ANALYZE_PALETTE = 1;
+const ANALYZE_AVERAGE = 2;
+const ANALYZE_LUMINANCE = 4;
+const ANALYZE_PLACEHOLDER = 8;
+
+export const analyzeImage = (
+  pixels: ArrayBuffer,
+  width: number,
+  height: number,
+  options: ImageAnalysisOptions = {}
+): ImageAnalysis => {
+  const {
+    palette = true,
+    averageColor = false,
+    luminanceHistogram = false,
+    placeholder = false,
+    colorCount = 5,
+    quality = 10,
+    ignoreWhite = true,
+  } = options;
+  const outputs =
+    (palette ? ANALYZE_PALETTE : 0) |
+    (averageColor ? ANALYZE_AVERAGE : 0) |
+    (luminanceHistogram ? ANALYZE_LUMINANCE : 0) |
+    (placeholder ? ANALYZE_PLACEHOLDER : 0);
+  const analysis = NitroPalette.analyzeImage(
+    pixels,
+    width,
+    height,
+    outputs,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+  return { ...analysis, palette: analysis.palette.slice(0, colorCount) };
+}
+
+export interface YuvPlane {
+  data: ArrayBuffer;
+  rowStride?: number;
+  pixelStride?: number;
+  offset?: number;
+}
+
+export interface YuvFrame {
+  width: number;
+  height: number;
+  y: YuvPlane;
+  u: YuvPlane;
+  v: YuvPlane;
+  matrix?: 'bt601' | 'bt709';
+  fullRange?: boolean;
+}
+
+export const getPaletteFromYuv = (
+  frame: YuvFrame,
+  colorCount: number = 5,
+  quality: number = 10,
+  ignoreWhite: boolean = true
+): string[] => {
+  const { y, u, v, matrix = 'bt601', fullRange = false } = frame;
+  const chromaWidth = Math.ceil(frame.width / 2);
+  const yPixelStride = y.pixelStride ?? 1;
+  const uPixelStride = u.pixelStride ?? 1;
+  const vPixelStride = v.pixelStride ?? 1;
+  const palette = NitroPalette.extractColorsFromYuv(
+    y.data,
+    u.data,
+    v.data,
+    frame.width,
+    frame.height,
+    y.rowStride ?? frame.width * yPixelStride,
+    yPixelStride,
+    u.rowStride ?? chromaWidth * uPixelStride,
+    uPixelStride,
+    u.offset ?? 0,
+    v.rowStride ?? chromaWidth * vPixelStride,
+    vPixelStride,
+    v.offset ?? 0,
+    matrix === 'bt709',
+    fullRange,
+    colorCount,
+    quality,
+    ignoreWhite
+  );
+  return palette.slice(0, colorCount);
+}
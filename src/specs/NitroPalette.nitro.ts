@@ -1,5 +1,26 @@
 import { type HybridObject } from 'react-native-nitro-modules'
 
+export interface BudgetedPalette {
+  colors: string[]
+  pixelsUsed: number
+  complete: boolean
+}
+
+export interface Swatch {
+  role: string
+  color: string
+  population: number
+  titleTextColor: string
+  bodyTextColor: string
+}
+
+export interface ImageAnalysis {
+  palette: string[]
+  averageColor: string
+  luminanceHistogram: number[]
+  placeholder: string
+}
+
 export interface NitroPalette
   extends HybridObject<{ ios: 'c++'; android: 'c++' }> {
   extractColors(
@@ -8,4 +29,150 @@ export interface NitroPalette
     quality: number,
     ignoreWhite: boolean,
   ): string[]
+  trackFrame(
+    source: ArrayBuffer,
+    colorCount: number,
+    ignoreWhite: boolean,
+  ): string[]
+  resetFrameTracking(): void
+  extractColorsWithBudget(
+    source: ArrayBuffer,
+    colorCount: number,
+    ignoreWhite: boolean,
+    budgetMs: number,
+    onEarlyResult: (colors: string[]) => void,
+  ): Promise<BudgetedPalette>
+  extractColorsFromEncoded(
+    source: ArrayBuffer,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+    maxDimension: number,
+  ): Promise<string[]>
+  extractColorsFromFile(
+    path: string,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+    maxDimension: number,
+  ): Promise<string[]>
+  createRequestId(): number
+  extractColorsAsync(
+    source: ArrayBuffer,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+    requestId: number,
+    priority: number,
+  ): Promise<string[]>
+  cancelExtraction(requestId: number): void
+  setExtractionPriority(requestId: number, priority: number): void
+  extractRegionColors(
+    source: ArrayBuffer,
+    width: number,
+    height: number,
+    columns: number,
+    rows: number,
+    edgeFraction: number,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): string[][]
+  indexPalettes(
+    ids: string[],
+    sources: ArrayBuffer[],
+    quality: number,
+    ignoreWhite: boolean,
+  ): Promise<void>
+  findSimilarPalettes(colors: number[], count: number): string[]
+  serializePaletteIndex(): ArrayBuffer
+  loadPaletteIndex(data: ArrayBuffer): void
+  clearPaletteIndex(): void
+  configureCache(directory: string): void
+  getCachedColors(
+    key: string,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): string[]
+  extractColorsCached(
+    key: string,
+    source: ArrayBuffer,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): string[]
+  ditherToPalette(
+    source: ArrayBuffer,
+    width: number,
+    height: number,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+    output: ArrayBuffer,
+  ): string[]
+  makeHistogram(
+    source: ArrayBuffer,
+    quality: number,
+    ignoreWhite: boolean,
+  ): ArrayBuffer
+  extractColorsFromHistograms(
+    histograms: ArrayBuffer[],
+    weights: number[],
+    colorCount: number,
+  ): string[]
+  extractCollectionColors(
+    sources: ArrayBuffer[],
+    weights: number[],
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): Promise<string[]>
+  extractSwatches(
+    source: ArrayBuffer,
+    quality: number,
+    ignoreWhite: boolean,
+  ): Swatch[]
+  extractColorsRefined(
+    source: ArrayBuffer,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): string[]
+  makePaletteTree(
+    source: ArrayBuffer,
+    maxColors: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): ArrayBuffer
+  extractColorsFromPaletteTree(tree: ArrayBuffer, colorCount: number): string[]
+  analyzeImage(
+    source: ArrayBuffer,
+    width: number,
+    height: number,
+    outputs: number,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): ImageAnalysis
+  extractColorsFromYuv(
+    y: ArrayBuffer,
+    u: ArrayBuffer,
+    v: ArrayBuffer,
+    width: number,
+    height: number,
+    yRowStride: number,
+    yPixelStride: number,
+    uRowStride: number,
+    uPixelStride: number,
+    uOffset: number,
+    vRowStride: number,
+    vPixelStride: number,
+    vOffset: number,
+    bt709: boolean,
+    fullRange: boolean,
+    colorCount: number,
+    quality: number,
+    ignoreWhite: boolean,
+  ): string[]
 }